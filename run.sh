@@ -11,7 +11,7 @@ DEBUG_FLAGS="-gdwarf-4 -O0 -fno-omit-frame-pointer"
 ASAN_FLAGS="-fsanitize=address -fno-common"
 SLOW_DEBUG_FLAGS="$DEBUG_FLAGS $ASAN_FLAGS"
 
-LIBS="-lm"
+LIBS="-lm -lpthread"
 
 UNITY_FLAGS="-DUNITY_INCLUDE_DOUBLE -DUNITY_INCLUDE_PRINT_FORMATTED -Itests"
 
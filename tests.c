@@ -374,8 +374,7 @@ void test_backward_gradient_accumulation(void) {
     TEST_ASSERT_EQUAL_DOUBLE(8.0, C->vals[0]);
     TEST_ASSERT_EQUAL_DOUBLE(14.0, D->vals[0]);
 
-    TENSOR_GRADS_SET(D, 1.0);
-    D->backward(D);
+    UNWRAP(tensor_backward_pass(D));
 
     TEST_ASSERT_EQUAL_DOUBLE(7.0, A->grads[0]);
     TEST_ASSERT_EQUAL_DOUBLE(2.0, X->grads[0]);
@@ -384,6 +383,1549 @@ void test_backward_gradient_accumulation(void) {
     tensor_free_recursive(D);
 }
 
+void test_backward_pass_shared_subgraph(void) {
+    tg_tensor_t* A = NULL;
+    TENSOR_CREATE_FILLED(&A, 2.0, 1);
+
+    // B is consumed twice by C and C twice by D, so a per-consumer
+    // traversal would push partial gradients through B and A.
+    tg_tensor_t* B = tensor_el_mul(A, A);
+    tg_tensor_t* C = tensor_el_add(B, B);
+    tg_tensor_t* D = tensor_el_mul(C, C);
+
+    TEST_ASSERT_EQUAL_DOUBLE(64.0, D->vals[0]);
+
+    UNWRAP(tensor_backward_pass(D));
+
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, D->grads[0]);
+    TEST_ASSERT_EQUAL_DOUBLE(16.0, C->grads[0]);
+    TEST_ASSERT_EQUAL_DOUBLE(32.0, B->grads[0]);
+    TEST_ASSERT_EQUAL_DOUBLE(128.0, A->grads[0]);
+
+    tensor_free_recursive(D);
+}
+
+void test_graph_topo_order_visits_each_node_once(void) {
+    tg_tensor_t* A = NULL;
+    tg_tensor_t* X = NULL;
+    TENSOR_CREATE_FILLED(&A, 1.0, 1);
+    TENSOR_CREATE_FILLED(&X, 1.0, 1);
+
+    tg_tensor_t* B = tensor_el_mul(A, X);
+    tg_tensor_t* C = tensor_el_add(A, B);
+    tg_tensor_t* D = tensor_el_sub(B, C);
+
+    tg_tensor_t** order = NULL;
+    size_t n_order = 0;
+    UNWRAP(tensor_graph_topo_order(D, &order, &n_order));
+
+    TEST_ASSERT_EQUAL(5, n_order);
+    TEST_ASSERT_EQUAL_PTR(D, order[n_order - 1]);
+    for (size_t i = 0; i < n_order; i++) {
+        for (size_t j = 0; j < order[i]->n_input_tensors; j++) {
+            bool seen_before = false;
+            for (size_t k = 0; k < i; k++) {
+                if (order[k] == order[i]->input_tensors[j]) { seen_before = true; }
+            }
+            TEST_ASSERT_TRUE(seen_before);
+        }
+    }
+
+    tensor_free_recursive(D);
+}
+
+void test_backward_and_free_deep_chain(void) {
+    // Deep enough that one C stack frame per node would overflow.
+    const size_t depth = 200000;
+
+    tg_tensor_t* X = NULL;
+    tg_tensor_t* one = NULL;
+    TENSOR_CREATE_FILLED(&X, 0.0, 1);
+    TENSOR_CREATE_FILLED(&one, 1.0, 1);
+
+    // Each node is owned by its consumer only, so freeing the head walks
+    // the whole chain.
+    tg_tensor_t* current = tensor_el_add(X, one);
+    for (size_t i = 1; i < depth; i++) {
+        tg_tensor_t* next = tensor_el_add(current, one);
+        current->ref_count -= 1;
+        current = next;
+    }
+    TEST_ASSERT_EQUAL_DOUBLE((double)depth, current->vals[0]);
+    TEST_ASSERT_EQUAL(depth + 1, one->ref_count);
+
+    UNWRAP(tensor_backward_pass(current));
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, X->grads[0]);
+    TEST_ASSERT_EQUAL_DOUBLE((double)depth, one->grads[0]);
+
+    // Every node released its references to the leaves.
+    tensor_free_recursive(current);
+    TEST_ASSERT_EQUAL(1, X->ref_count);
+    TEST_ASSERT_EQUAL(1, one->ref_count);
+    tensor_free(X);
+    tensor_free(one);
+    tensor_graph_scratch_release();
+}
+
+#ifndef TG_NO_THREADS
+static void* backward_on_thread(void* arg) {
+    tg_tensor_t* X = arg;
+    tg_tensor_t* square = tensor_el_mul(X, X);
+    tg_tensor_t* Y = tensor_sum(square, NULL, 0);
+    square->ref_count -= 1;
+    UNWRAP(tensor_backward_pass(Y));
+    tensor_free_recursive(Y);
+    // No tensor_graph_scratch_release: the scratch is freed at thread exit.
+    return NULL;
+}
+#endif
+
+void test_graph_scratch_freed_at_thread_exit(void) {
+#ifndef TG_NO_THREADS
+    tg_tensor_t* X = NULL;
+    TENSOR_CREATE_FILLED(&X, 3.0, 4);
+    tensor_set_requires_grad(X, true);
+
+    pthread_t worker;
+    TEST_ASSERT_EQUAL(0, pthread_create(&worker, NULL, backward_on_thread, X));
+    pthread_join(worker, NULL);
+    TEST_ASSERT_EQUAL_FLOAT(6.0f, X->grads[0]);
+    tensor_free(X);
+#endif
+}
+
+void test_tape_backward_matches_graph(void) {
+    tg_tensor_t* A = NULL;
+    tg_tensor_t* B = NULL;
+    TENSOR_CREATE_FILLED(&A, 2.0, 2);
+    TENSOR_CREATE_FILLED(&B, 4.0, 2);
+    A->vals[1] = 3.0;
+    B->vals[1] = 5.0;
+
+    tg_tape_t tape;
+    UNWRAP(tensor_tape_init(&tape, 4));
+
+    tensor_tape_begin(&tape);
+    tg_tensor_t* C = tensor_el_mul(A, B);
+    tg_tensor_t* D = tensor_el_add(C, A);
+    tg_tensor_t* L = tensor_el_div(D, B);
+    tensor_tape_end();
+
+    TEST_ASSERT_EQUAL(3, tape.n_records);
+    TEST_ASSERT_EQUAL(0, L->n_input_tensors);
+    TEST_ASSERT_EQUAL(1, A->ref_count);
+    TEST_ASSERT_EQUAL_DOUBLE(2.5, L->vals[0]);
+
+    UNWRAP(tensor_tape_backward(&tape, L));
+
+    // L = (A*B + A) / B = A + A/B
+    TEST_ASSERT_EQUAL_FLOAT(1.25, A->grads[0]);
+    TEST_ASSERT_EQUAL_FLOAT(1.2, A->grads[1]);
+    TEST_ASSERT_EQUAL_FLOAT(-0.125, B->grads[0]);
+    TEST_ASSERT_EQUAL_FLOAT(-0.12, B->grads[1]);
+
+    tg_tape_record_t* records = tape.records;
+    tensor_tape_reset(&tape);
+    TEST_ASSERT_EQUAL(0, tape.n_records);
+
+    tensor_tape_begin(&tape);
+    tg_tensor_t* E = tensor_el_sub(A, B);
+    tensor_tape_end();
+    TEST_ASSERT_EQUAL(1, tape.n_records);
+    TEST_ASSERT_EQUAL_PTR(records, tape.records);
+    TEST_ASSERT_EQUAL_PTR(E, tape.records[0].output);
+
+    tensor_tape_free(&tape);
+    tensor_free(A);
+    tensor_free(B);
+}
+
+void test_no_grad_skips_graph_and_grads(void) {
+    tg_tensor_t* W = NULL;
+    tg_tensor_t* X = NULL;
+    TENSOR_CREATE_FILLED(&W, 3.0, 4);
+    TENSOR_NO_GRAD(TENSOR_CREATE_FILLED(&X, 2.0, 4));
+
+    TEST_ASSERT_NULL(X->grads);
+
+    tg_tensor_t* Y = NULL;
+    tensor_no_grad_begin();
+    TENSOR_NO_GRAD(Y = tensor_el_mul(W, X));
+    TEST_ASSERT_FALSE(tensor_grad_enabled());
+    tensor_no_grad_end();
+    TEST_ASSERT_TRUE(tensor_grad_enabled());
+
+    TEST_ASSERT_EQUAL_DOUBLE(6.0, Y->vals[3]);
+    TEST_ASSERT_NULL(Y->grads);
+    TEST_ASSERT_NULL(Y->backward);
+    TEST_ASSERT_EQUAL(0, Y->n_input_tensors);
+    TEST_ASSERT_EQUAL(1, W->ref_count);
+    TEST_ASSERT_EQUAL(1, X->ref_count);
+    tensor_free(Y);
+
+    // Mixing a no-grad input into a tracked graph only skips that input.
+    tg_tensor_t* Z = tensor_el_mul(W, X);
+    UNWRAP(tensor_backward_pass(Z));
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, W->grads[0]);
+    TEST_ASSERT_NULL(X->grads);
+
+    tensor_free_recursive(Z);
+}
+
+void test_arena_step_reuses_memory(void) {
+    tg_tensor_t* W = NULL;
+    tg_tensor_t* X = NULL;
+    TENSOR_CREATE_FILLED(&W, 3.0, 8);
+    TENSOR_CREATE_FILLED(&X, 2.0, 8);
+
+    tg_arena_t arena;
+    UNWRAP(tensor_arena_init(&arena, 256));
+
+    tg_tensor_t* first = NULL;
+    for (size_t step = 0; step < 3; step++) {
+        tensor_arena_begin(&arena);
+        tg_tensor_t* Y = tensor_el_mul(W, X);
+        tg_tensor_t* L = tensor_el_add(Y, W);
+        tensor_arena_end();
+
+        TEST_ASSERT_EQUAL(TG_ALLOC_ARENA, L->alloc);
+        TEST_ASSERT_EQUAL_DOUBLE(9.0, L->vals[7]);
+        TEST_ASSERT_EQUAL(1, W->ref_count);
+
+        UNWRAP(tensor_backward_pass(L));
+        TEST_ASSERT_EQUAL_DOUBLE(3.0 * (step + 1), W->grads[0]);
+
+        // Freeing arena tensors is a no-op; the reset releases them.
+        tensor_free_recursive(L);
+        tensor_arena_reset(&arena);
+
+        if (step == 0) { first = Y; }
+        TEST_ASSERT_EQUAL_PTR(first, Y);
+    }
+
+    tensor_arena_free(&arena);
+    tensor_free(W);
+    tensor_free(X);
+}
+
+void test_pool_recycles_blocks(void) {
+    tg_pool_t pool;
+    tensor_pool_init(&pool, true);
+    tensor_pool_begin(&pool);
+
+    tg_tensor_t* W = NULL;
+    tg_tensor_t* X = NULL;
+    TENSOR_CREATE_FILLED(&W, 3.0, 16);
+    TENSOR_CREATE_FILLED(&X, 2.0, 16);
+    TEST_ASSERT_EQUAL(TG_ALLOC_POOL, W->alloc);
+
+    size_t warm_misses = 0;
+    for (size_t step = 0; step < 4; step++) {
+        tg_tensor_t* L = tensor_el_mul(W, X);
+        TEST_ASSERT_EQUAL_DOUBLE(6.0, L->vals[15]);
+        TEST_ASSERT_NULL(L->grads);
+
+        UNWRAP(tensor_backward_pass(L));
+        TEST_ASSERT_EQUAL_DOUBLE(2.0 * (step + 1), W->grads[0]);
+
+        tensor_free_recursive(L);
+        TEST_ASSERT_EQUAL(1, W->ref_count);
+
+        if (step == 0) { warm_misses = pool.misses; }
+    }
+    // Each later step recycles L's block and its grads buffer.
+    TEST_ASSERT_EQUAL(warm_misses, pool.misses);
+    TEST_ASSERT_EQUAL(6, pool.hits);
+
+    // A recycled block handed to tensor_init must still read as zeros.
+    tg_tensor_t* Z = NULL;
+    TENSOR_CREATE_ZEROS(&Z, 16);
+    for (size_t i = 0; i < Z->n_elements; i++) {
+        TEST_ASSERT_EQUAL_DOUBLE(0.0, Z->vals[i]);
+    }
+
+    tensor_free(Z);
+    tensor_free(W);
+    tensor_free(X);
+    tensor_pool_end();
+    tensor_pool_free(&pool);
+}
+
+void test_tensor_high_rank_shape(void) {
+    size_t dims[] = {2, 1, 3, 1, 2, 2};
+    tg_tensor_t* tensor = NULL;
+    TENSOR_CREATE_FILLED(&tensor, 1.0, 2, 1, 3, 1, 2, 2);
+
+    TEST_ASSERT_EQUAL(6, tensor->shape.n_dimensions);
+    TEST_ASSERT_EQUAL(24, tensor->n_elements);
+    for (size_t i = 0; i < tensor->shape.n_dimensions; i++) {
+        TEST_ASSERT_EQUAL_size_t(dims[i], tensor->shape.dimensions[i]);
+    }
+    TEST_ASSERT_EQUAL_size_t(12, tensor->shape.strides[0]);
+    TEST_ASSERT_EQUAL_size_t(1, tensor->shape.strides[5]);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, tensor->vals[23]);
+
+    tg_tensor_shape_t shape;
+    UNWRAP(tensor_shape_init(dims, 6, &shape));
+    TEST_ASSERT_EQUAL_size_t(4, shape.strides[3]);
+    tensor_shape_free(&shape);
+
+    tensor_free(tensor);
+}
+
+void test_requires_grad_controls_grad_storage(void) {
+    tg_tensor_t* W = NULL;
+    tg_tensor_t* X = NULL;
+    tg_tensor_t* Y = NULL;
+    TENSOR_CREATE_FILLED(&W, 3.0, 4);
+    TENSOR_CREATE_FILLED(&X, 2.0, 4);
+    TENSOR_CREATE_FILLED(&Y, 5.0, 4);
+    tensor_set_requires_grad(X, false);
+    tensor_set_requires_grad(Y, false);
+
+    TEST_ASSERT_TRUE(W->requires_grad);
+    TEST_ASSERT_NULL(W->grads);
+
+    // Ops on constants only produce constants.
+    tg_tensor_t* XY = tensor_el_add(X, Y);
+    TEST_ASSERT_FALSE(XY->requires_grad);
+    TEST_ASSERT_NULL(XY->backward);
+    TEST_ASSERT_EQUAL(1, X->ref_count);
+
+    tg_tensor_t* L = tensor_el_mul(W, XY);
+    TEST_ASSERT_TRUE(L->requires_grad);
+
+    UNWRAP(tensor_backward_pass(L));
+    TEST_ASSERT_EQUAL_DOUBLE(7.0, W->grads[0]);
+    TEST_ASSERT_NULL(XY->grads);
+    TEST_ASSERT_NULL(X->grads);
+    TEST_ASSERT_NULL(Y->grads);
+
+    tensor_free_recursive(L);
+    tensor_free(XY);
+    tensor_free(X);
+    tensor_free(Y);
+}
+
+void test_lazy_chain_matches_eager(void) {
+    tg_tensor_t* A = NULL;
+    tg_tensor_t* B = NULL;
+    tg_tensor_t* C = NULL;
+    tg_tensor_t* D = NULL;
+    TENSOR_CREATE_FILLED(&A, 2.0, 300);
+    TENSOR_CREATE_FILLED(&B, 3.0, 300);
+    TENSOR_CREATE_FILLED(&C, 4.0, 300);
+    TENSOR_CREATE_FILLED(&D, 5.0, 300);
+
+    tg_tensor_t* AB = NULL;
+    tg_tensor_t* ABC = NULL;
+    tg_tensor_t* E = NULL;
+    TENSOR_LAZY({
+        AB = tensor_el_mul(A, B);
+        ABC = tensor_el_add(AB, C);
+        E = tensor_el_div(ABC, D);
+    });
+
+    // E reads the four leaves directly; its intermediates are never computed.
+    TEST_ASSERT_TRUE(E->pending);
+    TEST_ASSERT_EQUAL(TG_BOP_FUSED_ELEMENTWISE, E->op);
+    TEST_ASSERT_EQUAL(4, E->n_input_tensors);
+    TEST_ASSERT_EQUAL(3, E->lazy_expr->n_ops);
+
+    UNWRAP(tensor_realize(E));
+    TEST_ASSERT_FALSE(E->pending);
+    TEST_ASSERT_EQUAL_FLOAT(2.0, E->vals[0]);
+    TEST_ASSERT_EQUAL_FLOAT(2.0, E->vals[299]);
+
+    UNWRAP(tensor_backward_pass(E));
+    TEST_ASSERT_TRUE(AB->pending);
+    TEST_ASSERT_EQUAL_FLOAT(0.6, A->grads[299]);
+    TEST_ASSERT_EQUAL_FLOAT(0.4, B->grads[0]);
+    TEST_ASSERT_EQUAL_FLOAT(0.2, C->grads[150]);
+    TEST_ASSERT_EQUAL_FLOAT(-0.4, D->grads[7]);
+
+    tensor_free_recursive(E);
+    tensor_free_recursive(ABC);
+    tensor_free_recursive(AB);
+}
+
+// Runs each elementwise op forward and backward on a length that leaves a
+// scalar tail for every vector width, and collects C, dA and dB.
+static void run_el_ops(tg_value_t out[4][3][37]) {
+    tg_tensor_t* (*const ops[4])(tg_tensor_t*, tg_tensor_t*) = {
+        tensor_el_add, tensor_el_sub, tensor_el_mul, tensor_el_div,
+    };
+    for (size_t k = 0; k < 4; k++) {
+        tg_tensor_t* A = NULL;
+        tg_tensor_t* B = NULL;
+        TENSOR_CREATE(&A, 37);
+        TENSOR_CREATE(&B, 37);
+        for (size_t i = 0; i < 37; i++) {
+            A->vals[i] = 1.0f + 0.37f * i;
+            B->vals[i] = 2.0f - 0.11f * i;
+        }
+        tg_tensor_t* C = ops[k](A, B);
+        UNWRAP(tensor_backward_pass(C));
+        memcpy(out[k][0], C->vals, sizeof(out[k][0]));
+        memcpy(out[k][1], A->grads, sizeof(out[k][1]));
+        memcpy(out[k][2], B->grads, sizeof(out[k][2]));
+        tensor_free_recursive(C);
+    }
+}
+
+void test_simd_kernels_match_scalar(void) {
+    tg_isa_t selected = tensor_simd_isa();
+    TEST_ASSERT_TRUE(tensor_simd_supported(selected));
+
+    static tg_value_t expected[4][3][37];
+    static tg_value_t actual[4][3][37];
+    UNWRAP(tensor_simd_select(TG_ISA_SCALAR));
+    run_el_ops(expected);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f / 2.0f, expected[3][0][0]);
+
+    for (tg_isa_t isa = TG_ISA_SSE2; isa <= TG_ISA_AVX512; isa++) {
+        if (tensor_simd_select(isa) != SUCCESS) {
+            TEST_ASSERT_FALSE(tensor_simd_supported(isa));
+            continue;
+        }
+        TEST_ASSERT_EQUAL(isa, tensor_simd_isa());
+        run_el_ops(actual);
+        TEST_ASSERT_EQUAL_MEMORY(expected, actual, sizeof(expected));
+    }
+
+    UNWRAP(tensor_simd_select(selected));
+}
+
+static void run_scalar_ops(tg_value_t out[37]) {
+    tg_tensor_t* A = NULL;
+    TENSOR_CREATE(&A, 37);
+    for (size_t i = 0; i < 37; i++) {
+        A->vals[i] = 3.0f - 0.29f * i;
+    }
+    UNWRAP(tensor_abs(A));
+    UNWRAP(tensor_scalar_add(A, 0.5));
+    UNWRAP(tensor_scalar_mul(A, 3.0));
+    UNWRAP(tensor_sqrt(A));
+    UNWRAP(tensor_scalar_sub(A, 1.0));
+    UNWRAP(tensor_scalar_div(A, 3.0));
+    TEST_ASSERT_EQUAL(6, tensor_version(A));
+    memcpy(out, A->vals, 37 * sizeof(tg_value_t));
+    tensor_free(A);
+}
+
+void test_simd_scalar_and_unary_kernels(void) {
+    tg_isa_t selected = tensor_simd_isa();
+    tg_value_t expected[37];
+    tg_value_t actual[37];
+
+    UNWRAP(tensor_simd_select(TG_ISA_SCALAR));
+    run_scalar_ops(expected);
+    TEST_ASSERT_EQUAL_FLOAT((sqrtf(3.5f * 3.0f) - 1.0f) / 3.0f, expected[0]);
+    TEST_ASSERT_EQUAL_FLOAT((sqrtf((0.29f * 36 - 3.0f + 0.5f) * 3.0f) - 1.0f) / 3.0f, expected[36]);
+
+    for (tg_isa_t isa = TG_ISA_SSE2; isa <= TG_ISA_AVX512; isa++) {
+        if (tensor_simd_select(isa) != SUCCESS) { continue; }
+        run_scalar_ops(actual);
+        TEST_ASSERT_EQUAL_MEMORY(expected, actual, sizeof(expected));
+    }
+
+    UNWRAP(tensor_simd_select(selected));
+}
+
+void test_dot_product_long_vectors(void) {
+    size_t n = (1 << 20) + 7;
+    tg_tensor_t* a = NULL;
+    tg_tensor_t* b = NULL;
+    TENSOR_CREATE(&a, n);
+    TENSOR_CREATE(&b, n);
+
+    double reference = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        a->vals[i] = 0.1f * (float)(i % 17) + 0.01f;
+        b->vals[i] = 1.0f - 0.03f * (float)(i % 5);
+        reference += (double)a->vals[i] * (double)b->vals[i];
+    }
+
+    tg_isa_t selected = tensor_simd_isa();
+    for (tg_isa_t isa = TG_ISA_SCALAR; isa <= TG_ISA_AVX512; isa++) {
+        if (tensor_simd_select(isa) != SUCCESS) { continue; }
+        TEST_ASSERT_DOUBLE_WITHIN(reference * 1e-6, reference, tensor_dot_product_f64(a, b));
+        TEST_ASSERT_FLOAT_WITHIN(reference * 1e-6, reference, tensor_dot_product(a, b));
+    }
+    UNWRAP(tensor_simd_select(selected));
+
+    tensor_free(a);
+    tensor_free(b);
+}
+
+void test_matmul_small(void) {
+    tg_tensor_t* A = NULL;
+    tg_tensor_t* B = NULL;
+    TENSOR_CREATE(&A, 2, 3);
+    TENSOR_CREATE(&B, 3, 2);
+    for (size_t i = 0; i < 6; i++) {
+        A->vals[i] = (tg_value_t)(i + 1);
+        B->vals[i] = (tg_value_t)(6 - i);
+    }
+
+    tg_tensor_t* C = tensor_matmul(A, B);
+    TEST_ASSERT_EQUAL(2, C->shape.dimensions[0]);
+    TEST_ASSERT_EQUAL(2, C->shape.dimensions[1]);
+    // [[1 2 3] [4 5 6]] x [[6 5] [4 3] [2 1]]
+    TEST_ASSERT_EQUAL_FLOAT(20.0, C->vals[0]);
+    TEST_ASSERT_EQUAL_FLOAT(14.0, C->vals[1]);
+    TEST_ASSERT_EQUAL_FLOAT(56.0, C->vals[2]);
+    TEST_ASSERT_EQUAL_FLOAT(41.0, C->vals[3]);
+
+    UNWRAP(tensor_backward_pass(C));
+    // dA = 1·Bᵀ: row sums of B; dB = Aᵀ·1: column sums of A.
+    TEST_ASSERT_EQUAL_FLOAT(11.0, A->grads[0]);
+    TEST_ASSERT_EQUAL_FLOAT(3.0, A->grads[5]);
+    TEST_ASSERT_EQUAL_FLOAT(5.0, B->grads[0]);
+    TEST_ASSERT_EQUAL_FLOAT(9.0, B->grads[5]);
+
+    tensor_free_recursive(C);
+}
+
+// Sizes straddle the register tile, and K spans two KC blocks.
+void test_matmul_blocked_matches_reference(void) {
+    size_t M = 70, K = 300, N = 45;
+    tg_tensor_t* A = NULL;
+    tg_tensor_t* B = NULL;
+    TENSOR_CREATE(&A, M, K);
+    TENSOR_CREATE(&B, K, N);
+    for (size_t i = 0; i < M * K; i++) { A->vals[i] = (tg_value_t)((i * 7) % 13) / 13.0f - 0.5f; }
+    for (size_t i = 0; i < K * N; i++) { B->vals[i] = (tg_value_t)((i * 5) % 11) / 11.0f - 0.5f; }
+
+    tg_tensor_t* C = tensor_matmul(A, B);
+    for (size_t m = 0; m < M; m++) {
+        for (size_t n = 0; n < N; n++) {
+            double expected = 0.0;
+            for (size_t k = 0; k < K; k++) { expected += (double)A->vals[m * K + k] * B->vals[k * N + n]; }
+            TEST_ASSERT_FLOAT_WITHIN(1e-4, expected, C->vals[m * N + n]);
+        }
+    }
+
+    UNWRAP(tensor_backward_pass(C));
+    for (size_t k = 0; k < K; k++) {
+        double row_sum = 0.0;
+        for (size_t n = 0; n < N; n++) { row_sum += B->vals[k * N + n]; }
+        TEST_ASSERT_FLOAT_WITHIN(1e-4, row_sum, A->grads[(M - 1) * K + k]);
+
+        double col_sum = 0.0;
+        for (size_t m = 0; m < M; m++) { col_sum += A->vals[m * K + k]; }
+        TEST_ASSERT_FLOAT_WITHIN(1e-4, col_sum, B->grads[k * N + N - 1]);
+    }
+
+    tensor_free_recursive(C);
+}
+
+static tg_tensor_t* matmul_with_threads(size_t n_threads, size_t M, size_t K, size_t N) {
+    tensor_set_num_threads(n_threads);
+    tg_tensor_t* A = NULL;
+    tg_tensor_t* B = NULL;
+    TENSOR_CREATE(&A, M, K);
+    TENSOR_CREATE(&B, K, N);
+    for (size_t i = 0; i < M * K; i++) { A->vals[i] = (tg_value_t)((i * 7) % 13) / 13.0f; }
+    for (size_t i = 0; i < K * N; i++) { B->vals[i] = (tg_value_t)((i * 5) % 11) / 11.0f; }
+
+    tg_tensor_t* C = NULL;
+    TENSOR_NO_GRAD(C = tensor_matmul(A, B));
+    tensor_free(A);
+    tensor_free(B);
+    return C;
+}
+
+void test_matmul_threads_match_serial(void) {
+    // Square, tall-skinny and short-wide products.
+    size_t shapes[][3] = {{150, 300, 130}, {1000, 64, 8}, {8, 64, 700}};
+    for (size_t i = 0; i < 3; i++) {
+        tg_tensor_t* serial = matmul_with_threads(1, shapes[i][0], shapes[i][1], shapes[i][2]);
+        tg_tensor_t* threaded = matmul_with_threads(4, shapes[i][0], shapes[i][1], shapes[i][2]);
+        TEST_ASSERT_EQUAL(4, tensor_get_num_threads());
+        TEST_ASSERT_EQUAL_MEMORY(serial->vals, threaded->vals, serial->n_elements * sizeof(tg_value_t));
+        tensor_free(serial);
+        tensor_free(threaded);
+    }
+    tensor_set_num_threads(0);
+}
+
+#ifndef TG_NO_THREADS
+static atomic_bool resize_pool_stop;
+
+static void* resize_pool_loop(void* arg) {
+    (void)arg;
+    while (!atomic_load(&resize_pool_stop)) {
+        tensor_set_num_threads(2);
+        tensor_set_num_threads(6);
+    }
+    return NULL;
+}
+#endif
+
+void test_matmul_survives_thread_count_changes(void) {
+    tg_tensor_t* expected = matmul_with_threads(1, 150, 300, 130);
+    tg_tensor_t* A = NULL;
+    tg_tensor_t* B = NULL;
+    TENSOR_CREATE(&A, 150, 300);
+    TENSOR_CREATE(&B, 300, 130);
+    for (size_t i = 0; i < A->n_elements; i++) { A->vals[i] = (tg_value_t)((i * 7) % 13) / 13.0f; }
+    for (size_t i = 0; i < B->n_elements; i++) { B->vals[i] = (tg_value_t)((i * 5) % 11) / 11.0f; }
+    tg_tensor_t* C = NULL;
+
+#ifndef TG_NO_THREADS
+    // Each product sizes its per-worker scratch from one reading of the
+    // thread count, however the pool is resized meanwhile.
+    pthread_t resizer;
+    atomic_store(&resize_pool_stop, false);
+    TEST_ASSERT_EQUAL(0, pthread_create(&resizer, NULL, resize_pool_loop, NULL));
+    for (size_t i = 0; i < 20; i++) {
+        TENSOR_NO_GRAD(C = tensor_matmul(A, B));
+        TEST_ASSERT_EQUAL_MEMORY(expected->vals, C->vals, C->n_elements * sizeof(tg_value_t));
+        tensor_free(C);
+    }
+    atomic_store(&resize_pool_stop, true);
+    pthread_join(resizer, NULL);
+#endif
+
+    // After a shutdown the next parallel job starts the workers again.
+    tensor_set_num_threads(4);
+    tensor_thread_pool_shutdown();
+    TENSOR_NO_GRAD(C = tensor_matmul(A, B));
+    TEST_ASSERT_EQUAL_MEMORY(expected->vals, C->vals, C->n_elements * sizeof(tg_value_t));
+    tensor_thread_pool_shutdown();
+    tensor_set_num_threads(0);
+
+    tensor_free(C);
+    tensor_free(A);
+    tensor_free(B);
+    tensor_free(expected);
+}
+
+static void fill_pattern(tg_tensor_t* t, size_t seed) {
+    for (size_t i = 0; i < t->n_elements; i++) {
+        t->vals[i] = (tg_value_t)(((i + seed) * 7) % 13) / 13.0f - 0.5f;
+    }
+}
+
+// Checks C = A·B and the grads of a backward pass seeded with ones, where a
+// zero stride marks an operand shared by the whole batch.
+static void check_batched_matmul(tg_tensor_t* A, tg_tensor_t* B, tg_tensor_t* C, size_t batch,
+                                 size_t M, size_t K, size_t N, size_t a_stride, size_t b_stride) {
+    for (size_t i = 0; i < batch; i++) {
+        const tg_value_t* a = A->vals + i * a_stride;
+        const tg_value_t* b = B->vals + i * b_stride;
+        for (size_t m = 0; m < M; m++) {
+            for (size_t n = 0; n < N; n++) {
+                double expected = 0.0;
+                for (size_t k = 0; k < K; k++) { expected += (double)a[m * K + k] * b[k * N + n]; }
+                TEST_ASSERT_FLOAT_WITHIN(1e-5 * (1 + fabs(expected)), expected, C->vals[(i * M + m) * N + n]);
+            }
+        }
+    }
+
+    UNWRAP(tensor_backward_pass(C));
+    size_t a_items = a_stride ? batch : 1;
+    size_t b_items = b_stride ? batch : 1;
+    for (size_t j = 0; j < a_items; j++) {
+        for (size_t k = 0; k < K; k++) {
+            double expected = 0.0;
+            for (size_t i = 0; i < batch; i++) {
+                if (a_stride && i != j) { continue; }
+                for (size_t n = 0; n < N; n++) { expected += B->vals[i * b_stride + k * N + n]; }
+            }
+            TEST_ASSERT_FLOAT_WITHIN(1e-5 * (1 + fabs(expected)), expected, A->grads[j * a_stride + (M - 1) * K + k]);
+        }
+    }
+    for (size_t j = 0; j < b_items; j++) {
+        for (size_t k = 0; k < K; k++) {
+            double expected = 0.0;
+            for (size_t i = 0; i < batch; i++) {
+                if (b_stride && i != j) { continue; }
+                for (size_t m = 0; m < M; m++) { expected += A->vals[i * a_stride + m * K + k]; }
+            }
+            TEST_ASSERT_FLOAT_WITHIN(1e-5 * (1 + fabs(expected)), expected, B->grads[j * b_stride + k * N + N - 1]);
+        }
+    }
+}
+
+void test_batched_matmul(void) {
+    tensor_set_num_threads(4);
+
+    tg_tensor_t* A = NULL;
+    tg_tensor_t* B = NULL;
+    TENSOR_CREATE(&A, 2, 3, 4, 5);
+    TENSOR_CREATE(&B, 2, 3, 5, 6);
+    fill_pattern(A, 0);
+    fill_pattern(B, 3);
+    tg_tensor_t* C = tensor_matmul(A, B);
+    TEST_ASSERT_EQUAL(4, C->shape.n_dimensions);
+    TEST_ASSERT_EQUAL(3, C->shape.dimensions[1]);
+    TEST_ASSERT_EQUAL(6, C->shape.dimensions[3]);
+    check_batched_matmul(A, B, C, 6, 4, 5, 6, 20, 30);
+    tensor_free_recursive(C);
+
+    // Shared weights: [64, 4, 5] x [5, 6].
+    TENSOR_CREATE(&A, 64, 4, 5);
+    TENSOR_CREATE(&B, 5, 6);
+    fill_pattern(A, 1);
+    fill_pattern(B, 2);
+    C = tensor_matmul(A, B);
+    TEST_ASSERT_EQUAL(64, C->shape.dimensions[0]);
+    check_batched_matmul(A, B, C, 64, 4, 5, 6, 20, 0);
+    tensor_free_recursive(C);
+
+    // Shared left operand: [4, 5] x [64, 5, 6].
+    TENSOR_CREATE(&A, 4, 5);
+    TENSOR_CREATE(&B, 64, 5, 6);
+    fill_pattern(A, 5);
+    fill_pattern(B, 4);
+    C = tensor_matmul(A, B);
+    TEST_ASSERT_EQUAL(64, C->shape.dimensions[0]);
+    check_batched_matmul(A, B, C, 64, 4, 5, 6, 0, 30);
+    tensor_free_recursive(C);
+
+    tensor_set_num_threads(0);
+}
+
+// Batch-1 linear layers in both orientations: the forward passes and the
+// input grads are matrix-vector products, the weight grads outer products.
+void test_matmul_unit_dims(void) {
+    tensor_set_num_threads(4);
+    size_t shapes[][3] = {{1, 300, 900}, {700, 400, 1}, {1, 5, 7}, {9, 6, 1}, {13, 1, 11}};
+    for (size_t i = 0; i < 5; i++) {
+        size_t M = shapes[i][0], K = shapes[i][1], N = shapes[i][2];
+        tg_tensor_t* A = NULL;
+        tg_tensor_t* B = NULL;
+        TENSOR_CREATE(&A, M, K);
+        TENSOR_CREATE(&B, K, N);
+        fill_pattern(A, i);
+        fill_pattern(B, i + 1);
+        tg_tensor_t* C = tensor_matmul(A, B);
+        check_batched_matmul(A, B, C, 1, M, K, N, M * K, K * N);
+        tensor_free_recursive(C);
+    }
+    tensor_set_num_threads(0);
+}
+
+void test_inplace_ops_bump_version(void) {
+    tg_tensor_t* A = NULL;
+    tg_tensor_t* B = NULL;
+    TENSOR_CREATE_FILLED(&A, 6.0, 3);
+    TENSOR_CREATE_FILLED(&B, 2.0, 3);
+    tensor_set_requires_grad(A, false);
+    tensor_set_requires_grad(B, false);
+
+    UNWRAP(tensor_el_add_(A, B));
+    TEST_ASSERT_EQUAL_DOUBLE(8.0, A->vals[0]);
+    UNWRAP(tensor_el_sub_(A, B));
+    TEST_ASSERT_EQUAL_DOUBLE(6.0, A->vals[1]);
+    UNWRAP(tensor_el_mul_(A, B));
+    TEST_ASSERT_EQUAL_DOUBLE(12.0, A->vals[2]);
+    UNWRAP(tensor_el_div_(A, B));
+    TEST_ASSERT_EQUAL_DOUBLE(6.0, A->vals[0]);
+    UNWRAP(tensor_scalar_mul(A, 0.5));
+
+    TEST_ASSERT_EQUAL(5, tensor_version(A));
+    TEST_ASSERT_EQUAL(0, tensor_version(B));
+
+    tensor_free(A);
+    tensor_free(B);
+}
+
+void test_inplace_ops_reject_graph_tensors(void) {
+    tg_tensor_t* A = NULL;
+    tg_tensor_t* B = NULL;
+    tg_tensor_t* D = NULL;
+    TENSOR_CREATE_FILLED(&A, 2.0, 2);
+    TENSOR_CREATE_FILLED(&B, 3.0, 2);
+    TENSOR_CREATE_FILLED(&D, 1.0, 2);
+
+    // Modifying a graph output would leave backward with stale gradients
+    // and D with none, so the call is refused and nothing is written.
+    tg_tensor_t* C = tensor_el_mul(A, B);
+    TEST_ASSERT_EQUAL(ERR_INPLACE_REQUIRES_GRAD, tensor_el_add_(C, D));
+    TEST_ASSERT_EQUAL(ERR_INPLACE_REQUIRES_GRAD, tensor_el_mul_(C, D));
+    TEST_ASSERT_EQUAL_DOUBLE(6.0, C->vals[0]);
+    TEST_ASSERT_EQUAL(0, tensor_version(C));
+    UNWRAP(tensor_backward_pass(C));
+    TEST_ASSERT_EQUAL_DOUBLE(3.0, A->grads[0]);
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, B->grads[0]);
+    TEST_ASSERT_NULL(D->grads);
+
+    // A plain buffer cannot take values from a tensor that requires grad either.
+    tg_tensor_t* E = NULL;
+    TENSOR_CREATE_FILLED(&E, 0.0, 2);
+    tensor_set_requires_grad(E, false);
+    TEST_ASSERT_EQUAL(ERR_INPLACE_REQUIRES_GRAD, tensor_el_sub_(E, D));
+    TENSOR_NO_GRAD(UNWRAP(tensor_el_sub_(E, D)));
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, E->vals[1]);
+
+    tensor_free_recursive(C);
+    tensor_free(A);
+    tensor_free(B);
+    tensor_free(D);
+    tensor_free(E);
+}
+
+void test_backward_detects_modified_saved_input(void) {
+    tg_tensor_t* A = NULL;
+    tg_tensor_t* B = NULL;
+    TENSOR_CREATE_FILLED(&A, 2.0, 2);
+    TENSOR_CREATE_FILLED(&B, 3.0, 2);
+
+    tg_tensor_t* C = tensor_el_mul(A, B);
+    TENSOR_NO_GRAD(UNWRAP(tensor_el_add_(A, B)));
+    TEST_ASSERT_EQUAL(ERR_SAVED_TENSOR_MODIFIED, tensor_backward_pass(C));
+    tensor_free_recursive(C);
+
+    // Addition does not read its inputs, so overwriting them is harmless.
+    tg_tensor_t* D = tensor_el_add(A, B);
+    TENSOR_NO_GRAD(UNWRAP(tensor_scalar_add(B, 1.0)));
+    UNWRAP(tensor_backward_pass(D));
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, B->grads[0]);
+    tensor_free_recursive(D);
+
+    tg_tape_t tape;
+    UNWRAP(tensor_tape_init(&tape, 1));
+    tensor_tape_begin(&tape);
+    tg_tensor_t* E = tensor_el_div(A, B);
+    tensor_tape_end();
+    UNWRAP(tensor_sqrt(B));
+    TEST_ASSERT_EQUAL(ERR_SAVED_TENSOR_MODIFIED, tensor_tape_backward(&tape, E));
+    tensor_tape_free(&tape);
+
+    tensor_free(A);
+    tensor_free(B);
+}
+
+// NaN, infinities and signed zeros must match exactly; other values closely.
+static void assert_matches_libm(float expected, float actual) {
+    if (isnan(expected)) {
+        TEST_ASSERT_TRUE(isnan(actual));
+    } else if (isinf(expected) || expected == 0.0f) {
+        TEST_ASSERT_EQUAL_FLOAT(expected, actual);
+        TEST_ASSERT_EQUAL(signbit(expected), signbit(actual));
+    } else {
+        TEST_ASSERT_FLOAT_WITHIN(2e-6f * (1.0f + fabsf(expected)), expected, actual);
+    }
+}
+
+void test_activations_match_libm(void) {
+    tg_tensor_t* X = NULL;
+    tg_tensor_t* P = NULL;
+    TENSOR_CREATE(&X, 67);
+    TENSOR_CREATE(&P, 67);
+    for (size_t i = 0; i < 67; i++) {
+        X->vals[i] = -9.0f + 0.27f * (float)i;
+        P->vals[i] = expf(X->vals[i]);
+    }
+
+    // Every ISA must give the scalar kernels' results bit for bit.
+    float scalar_results[4][67];
+    tg_isa_t selected = tensor_simd_isa();
+    for (tg_isa_t isa = TG_ISA_SCALAR; isa <= TG_ISA_AVX512; isa++) {
+        if (tensor_simd_select(isa) != SUCCESS) { continue; }
+        tg_tensor_t* R = tensor_relu(X);
+        tg_tensor_t* S = tensor_sigmoid(X);
+        tg_tensor_t* T = tensor_tanh(X);
+        tg_tensor_t* E = tensor_exp(X);
+        tg_tensor_t* L = tensor_log(P);
+        const tg_tensor_t* results[] = { S, T, E, L };
+        for (size_t k = 0; k < 4; k++) {
+            if (isa == TG_ISA_SCALAR) {
+                memcpy(scalar_results[k], results[k]->vals, sizeof(scalar_results[k]));
+            }
+            TEST_ASSERT_EQUAL_MEMORY(scalar_results[k], results[k]->vals, sizeof(scalar_results[k]));
+        }
+        for (size_t i = 0; i < 67; i++) {
+            float x = X->vals[i];
+            TEST_ASSERT_EQUAL_FLOAT(x > 0 ? x : 0.0f, R->vals[i]);
+            TEST_ASSERT_FLOAT_WITHIN(4e-7f, 1.0f / (1.0f + expf(-x)), S->vals[i]);
+            TEST_ASSERT_FLOAT_WITHIN(4e-7f, tanhf(x), T->vals[i]);
+            TEST_ASSERT_FLOAT_WITHIN(4e-7f * expf(x), expf(x), E->vals[i]);
+            TEST_ASSERT_FLOAT_WITHIN(1e-6f * (1.0f + fabsf(x)), logf(P->vals[i]), L->vals[i]);
+        }
+        tensor_free_recursive(R);
+        tensor_free_recursive(S);
+        tensor_free_recursive(T);
+        tensor_free_recursive(E);
+        tensor_free_recursive(L);
+    }
+    UNWRAP(tensor_simd_select(selected));
+
+    float edges[] = { -100.0f, 100.0f, 0.0f };
+    tg_tensor_t* Y = NULL;
+    TENSOR_CREATE(&Y, 3);
+    memcpy(Y->vals, edges, sizeof(edges));
+    tg_tensor_t* E = tensor_exp(Y);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, E->vals[0]);
+    TEST_ASSERT_TRUE(isinf(E->vals[1]));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, E->vals[2]);
+    tensor_free_recursive(E);
+    tensor_free(Y);
+
+    // Special inputs, repeated so that each goes through the vector body
+    // and the scalar tail of every ISA.
+    float specials[] = { NAN, -NAN, INFINITY, -INFINITY, 0.0f, -0.0f, 1e-40f, -1e-40f,
+                         FLT_MIN, FLT_MAX, -1.0f, 1e-30f, 0.5f };
+    size_t n_specials = sizeof(specials) / sizeof(specials[0]);
+    tg_tensor_t* Z = NULL;
+    TENSOR_CREATE(&Z, 3 * n_specials);
+    for (size_t i = 0; i < Z->n_elements; i++) { Z->vals[i] = specials[i % n_specials]; }
+    for (tg_isa_t isa = TG_ISA_SCALAR; isa <= TG_ISA_AVX512; isa++) {
+        if (tensor_simd_select(isa) != SUCCESS) { continue; }
+        tg_tensor_t* R = tensor_relu(Z);
+        tg_tensor_t* S = tensor_sigmoid(Z);
+        tg_tensor_t* T = tensor_tanh(Z);
+        tg_tensor_t* E = tensor_exp(Z);
+        tg_tensor_t* L = tensor_log(Z);
+        for (size_t i = 0; i < Z->n_elements; i++) {
+            float z = Z->vals[i];
+            assert_matches_libm(isnan(z) || z > 0 ? z : 0.0f, R->vals[i]);
+            assert_matches_libm(1.0f / (1.0f + expf(-z)), S->vals[i]);
+            assert_matches_libm(tanhf(z), T->vals[i]);
+            assert_matches_libm(expf(z), E->vals[i]);
+            assert_matches_libm(logf(z), L->vals[i]);
+        }
+        tensor_free_recursive(R);
+        tensor_free_recursive(S);
+        tensor_free_recursive(T);
+        tensor_free_recursive(E);
+        tensor_free_recursive(L);
+    }
+    UNWRAP(tensor_simd_select(selected));
+    tensor_free(Z);
+
+    tensor_free(X);
+    tensor_free(P);
+}
+
+void test_activation_backward(void) {
+    tg_tensor_t* X = NULL;
+    TENSOR_CREATE(&X, 21);
+    for (size_t i = 0; i < 21; i++) {
+        X->vals[i] = -2.5f + 0.25f * (float)i;
+    }
+
+    // L = sum(relu(X) + sigmoid(X) + tanh(X) + exp(X)) through the graph,
+    // then the same through a tape.
+    tg_tensor_t* S = tensor_sigmoid(X);
+    tg_tensor_t* T = tensor_tanh(X);
+    tg_tensor_t* L = tensor_el_add(tensor_el_add(tensor_relu(X), S), tensor_el_add(T, tensor_exp(X)));
+    UNWRAP(tensor_backward_pass(L));
+    for (size_t i = 0; i < 21; i++) {
+        float x = X->vals[i];
+        float s = 1.0f / (1.0f + expf(-x));
+        float t = tanhf(x);
+        float expected = (x > 0 ? 1.0f : 0.0f) + s * (1.0f - s) + (1.0f - t * t) + expf(x);
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f * (1.0f + expected), expected, X->grads[i]);
+    }
+    tensor_free_recursive(L);
+
+    tg_tensor_t* P = NULL;
+    TENSOR_CREATE_FILLED(&P, 4.0, 3);
+    tg_tape_t tape;
+    UNWRAP(tensor_tape_init(&tape, 4));
+    tensor_tape_begin(&tape);
+    tg_tensor_t* G = tensor_log(P);
+    tensor_tape_end();
+    UNWRAP(tensor_tape_backward(&tape, G));
+    TEST_ASSERT_EQUAL_FLOAT(0.25f, P->grads[0]);
+    tensor_tape_free(&tape);
+
+    // sigmoid's gradient reads its own output.
+    tg_tensor_t* Y = tensor_sigmoid(P);
+    TENSOR_NO_GRAD(UNWRAP(tensor_scalar_mul(Y, 2.0)));
+    TEST_ASSERT_EQUAL(ERR_SAVED_TENSOR_MODIFIED, tensor_backward_pass(Y));
+    tensor_free_recursive(Y);
+
+    tensor_free(P);
+    tensor_free(X);
+}
+
+void test_softmax_cross_entropy(void) {
+    // Rows of 1000 classes whose max grows across logsumexp chunks, with
+    // magnitudes that would overflow a naive exp.
+    size_t rows = 5, classes = 1000;
+    tg_tensor_t* Z = NULL;
+    tg_tensor_t* T = NULL;
+    TENSOR_CREATE(&Z, rows, classes);
+    TENSOR_CREATE(&T, rows);
+    tensor_set_requires_grad(T, false);
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t c = 0; c < classes; c++) {
+            Z->vals[r * classes + c] = 200.0f * (float)r + 0.01f * (float)c + 2.0f * sinf((float)(c * (r + 1)));
+        }
+        T->vals[r] = (float)((r * 397) % classes);
+    }
+
+    double expected_loss = 0.0;
+    double lse[5];
+    for (size_t r = 0; r < rows; r++) {
+        const float* z = Z->vals + r * classes;
+        double m = -INFINITY, sum = 0.0;
+        for (size_t c = 0; c < classes; c++) { m = fmax(m, z[c]); }
+        for (size_t c = 0; c < classes; c++) { sum += exp(z[c] - m); }
+        lse[r] = m + log(sum);
+        expected_loss += (lse[r] - z[(size_t)T->vals[r]]) / (double)rows;
+    }
+
+    tg_isa_t selected = tensor_simd_isa();
+    for (tg_isa_t isa = TG_ISA_SCALAR; isa <= TG_ISA_AVX512; isa++) {
+        if (tensor_simd_select(isa) != SUCCESS) { continue; }
+        tg_tensor_t* L = tensor_softmax_cross_entropy(Z, T);
+        TEST_ASSERT_EQUAL(1, L->n_elements);
+        TEST_ASSERT_FLOAT_WITHIN(1e-4f, (float)expected_loss, L->vals[0]);
+
+        UNWRAP(tensor_backward_pass(L));
+        TEST_ASSERT_NULL(T->grads);
+        for (size_t r = 0; r < rows; r++) {
+            for (size_t c = 0; c < classes; c++) {
+                size_t i = r * classes + c;
+                double expected = (exp(Z->vals[i] - lse[r]) - (c == (size_t)T->vals[r])) / (double)rows;
+                TEST_ASSERT_FLOAT_WITHIN(1e-7f + 1e-5f * fabsf((float)expected), (float)expected, Z->grads[i]);
+            }
+        }
+        memset(Z->grads, 0, Z->n_elements * sizeof(tg_value_t));
+        tensor_free(L);
+    }
+    UNWRAP(tensor_simd_select(selected));
+
+    // The tape path accumulates the same gradient.
+    tg_tape_t tape;
+    UNWRAP(tensor_tape_init(&tape, 1));
+    tensor_tape_begin(&tape);
+    tg_tensor_t* L = tensor_softmax_cross_entropy(Z, T);
+    tensor_tape_end();
+    UNWRAP(tensor_tape_backward(&tape, L));
+    size_t t0 = (size_t)T->vals[0];
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, (float)((exp(Z->vals[t0] - lse[0]) - 1.0) / rows), Z->grads[t0]);
+    tensor_tape_free(&tape);
+
+    tensor_free(Z);
+    tensor_free(T);
+}
+
+void test_softmax_cross_entropy_rejects_bad_targets(void) {
+    tg_tensor_t* Z = NULL;
+    tg_tensor_t* T = NULL;
+    TENSOR_CREATE(&Z, 2, 3);
+    TENSOR_CREATE(&T, 2);
+    tensor_set_requires_grad(T, false);
+    fill_pattern(Z, 3);
+    T->vals[1] = 2.0f;
+
+    // Targets written behind the graph's back (no version bump) are checked
+    // again in backward, before any gradient is written.
+    float bad[] = { 3.0f, -1.0f, 0.5f, NAN, 1e9f };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        T->vals[0] = 1.0f;
+        tg_tensor_t* L = tensor_softmax_cross_entropy(Z, T);
+        T->vals[0] = bad[i];
+        TEST_ASSERT_EQUAL(ERR_INVALID_TARGET, tensor_backward_pass(L));
+        for (size_t j = 0; j < Z->n_elements; j++) { TEST_ASSERT_EQUAL_FLOAT(0.0f, Z->grads[j]); }
+        tensor_free(L);
+    }
+
+    tensor_free(Z);
+    tensor_free(T);
+}
+
+void test_sum_mean_axes(void) {
+    tg_tensor_t* X = NULL;
+    TENSOR_CREATE(&X, 2, 3, 4);
+    fill_pattern(X, 1);
+
+    size_t middle[] = {1};
+    tg_tensor_t* S = tensor_sum(X, middle, 1);
+    TEST_ASSERT_EQUAL(3, S->shape.n_dimensions);
+    TEST_ASSERT_EQUAL(1, S->shape.dimensions[1]);
+    TEST_ASSERT_EQUAL(8, S->n_elements);
+    for (size_t a = 0; a < 2; a++) {
+        for (size_t c = 0; c < 4; c++) {
+            float expected = 0.0f;
+            for (size_t b = 0; b < 3; b++) { expected += X->vals[a * 12 + b * 4 + c]; }
+            TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected, S->vals[a * 4 + c]);
+        }
+    }
+
+    size_t last[] = {2};
+    tg_tensor_t* M = tensor_mean(X, last, 1);
+    for (size_t j = 0; j < 6; j++) {
+        float expected = 0.0f;
+        for (size_t c = 0; c < 4; c++) { expected += X->vals[j * 4 + c]; }
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected / 4.0f, M->vals[j]);
+    }
+    tensor_free(S);
+    tensor_free(M);
+
+    // L = sum(sum(X, {0, 2}) * W), so dL/dX[a, b, c] = W[b].
+    size_t outer[] = {0, 2};
+    tg_tensor_t* W = NULL;
+    TENSOR_CREATE(&W, 1, 3, 1);
+    W->vals[0] = 1.0f;
+    W->vals[1] = 2.0f;
+    W->vals[2] = 3.0f;
+    tg_tensor_t* L = tensor_sum(tensor_el_mul(tensor_sum(X, outer, 2), W), NULL, 0);
+    TEST_ASSERT_EQUAL(1, L->n_elements);
+    float total = 0.0f;
+    for (size_t i = 0; i < 24; i++) { total += X->vals[i] * (float)((i / 4) % 3 + 1); }
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, total, L->vals[0]);
+    UNWRAP(tensor_backward_pass(L));
+    for (size_t i = 0; i < 24; i++) {
+        TEST_ASSERT_EQUAL_FLOAT((float)((i / 4) % 3 + 1), X->grads[i]);
+    }
+    tensor_free_recursive(L);
+
+    // Mean of everything through a tape: every grad is 1/24.
+    memset(X->grads, 0, 24 * sizeof(tg_value_t));
+    tg_tape_t tape;
+    UNWRAP(tensor_tape_init(&tape, 1));
+    tensor_tape_begin(&tape);
+    tg_tensor_t* mean = tensor_mean(X, NULL, 0);
+    tensor_tape_end();
+    UNWRAP(tensor_tape_backward(&tape, mean));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f / 24.0f, X->grads[23]);
+    tensor_tape_free(&tape);
+
+    tensor_free(W);
+    tensor_free(X);
+}
+
+static tg_tensor_t* sum_with_threads(tg_tensor_t* X, size_t n_threads, const size_t axes[], size_t n_axes) {
+    tensor_set_num_threads(n_threads);
+    tg_tensor_t* S = NULL;
+    TENSOR_NO_GRAD(S = tensor_sum(X, axes, n_axes));
+    return S;
+}
+
+void test_sum_threads_match_serial(void) {
+    size_t rows = 700, cols = 1000;
+    tg_tensor_t* X = NULL;
+    TENSOR_CREATE(&X, rows, cols);
+    fill_pattern(X, 3);
+    double reference = 0.0;
+    for (size_t i = 0; i < X->n_elements; i++) { reference += X->vals[i]; }
+
+    size_t by_row[] = {1};
+    size_t by_col[] = {0};
+    const size_t* axes[] = {NULL, by_row, by_col};
+    size_t n_axes[] = {0, 1, 1};
+    for (size_t k = 0; k < 3; k++) {
+        tg_tensor_t* serial = sum_with_threads(X, 1, axes[k], n_axes[k]);
+        tg_tensor_t* threaded = sum_with_threads(X, 4, axes[k], n_axes[k]);
+        TEST_ASSERT_EQUAL_MEMORY(serial->vals, threaded->vals, serial->n_elements * sizeof(tg_value_t));
+        double total = 0.0;
+        for (size_t i = 0; i < serial->n_elements; i++) { total += serial->vals[i]; }
+        TEST_ASSERT_DOUBLE_WITHIN(fabs(reference) * 1e-6, reference, total);
+        tensor_free(serial);
+        tensor_free(threaded);
+    }
+    tensor_set_num_threads(0);
+    tensor_free(X);
+}
+
+void test_broadcast_el_ops(void) {
+    tg_tensor_t* X = NULL;
+    tg_tensor_t* bias = NULL;
+    tg_tensor_t* scale = NULL;
+    TENSOR_CREATE(&X, 4, 3);
+    TENSOR_CREATE(&bias, 3);
+    TENSOR_CREATE(&scale, 4, 1);
+    fill_pattern(X, 2);
+    for (size_t j = 0; j < 3; j++) { bias->vals[j] = (float)j + 1.0f; }
+    for (size_t i = 0; i < 4; i++) { scale->vals[i] = 0.5f * (float)i + 1.0f; }
+
+    // Y = (X + bias) * scale: bias is read along rows, scale along columns.
+    tg_tensor_t* Y = tensor_el_mul(tensor_el_add(X, bias), scale);
+    TEST_ASSERT_EQUAL(2, Y->shape.n_dimensions);
+    TEST_ASSERT_EQUAL(4, Y->shape.dimensions[0]);
+    TEST_ASSERT_EQUAL(3, Y->shape.dimensions[1]);
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            TEST_ASSERT_EQUAL_FLOAT((X->vals[i * 3 + j] + bias->vals[j]) * scale->vals[i], Y->vals[i * 3 + j]);
+        }
+    }
+
+    UNWRAP(tensor_backward_pass(Y));
+    for (size_t j = 0; j < 3; j++) {
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.0f + 1.5f + 2.0f + 2.5f, bias->grads[j]);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        float row = 0.0f;
+        for (size_t j = 0; j < 3; j++) {
+            row += X->vals[i * 3 + j] + bias->vals[j];
+            TEST_ASSERT_EQUAL_FLOAT(scale->vals[i], X->grads[i * 3 + j]);
+        }
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, row, scale->grads[i]);
+    }
+    tensor_free_recursive(Y);
+
+    // [3, 1] / [1, 4] -> [3, 4], through a tape.
+    tg_tensor_t* U = NULL;
+    tg_tensor_t* V = NULL;
+    TENSOR_CREATE(&U, 3, 1);
+    TENSOR_CREATE(&V, 1, 4);
+    for (size_t i = 0; i < 3; i++) { U->vals[i] = (float)i + 1.0f; }
+    for (size_t j = 0; j < 4; j++) { V->vals[j] = (float)j + 2.0f; }
+    tg_tape_t tape;
+    UNWRAP(tensor_tape_init(&tape, 1));
+    tensor_tape_begin(&tape);
+    tg_tensor_t* Q = tensor_el_div(U, V);
+    tensor_tape_end();
+    TEST_ASSERT_EQUAL(12, Q->n_elements);
+    TEST_ASSERT_EQUAL_FLOAT(3.0f / 5.0f, Q->vals[2 * 4 + 3]);
+    UNWRAP(tensor_tape_backward(&tape, Q));
+    float inv_sum = 1.0f / 2 + 1.0f / 3 + 1.0f / 4 + 1.0f / 5;
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, inv_sum, U->grads[1]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, -(1.0f + 2.0f + 3.0f) / 9.0f, V->grads[1]);
+    tensor_tape_free(&tape);
+
+    // In place, bias broadcasts into X.
+    TENSOR_NO_GRAD(UNWRAP(tensor_el_sub_(X, bias)));
+    TEST_ASSERT_EQUAL_FLOAT((float)(((0 + 2) * 7) % 13) / 13.0f - 0.5f - 1.0f, X->vals[0]);
+
+    tensor_free(U);
+    tensor_free(V);
+    tensor_free(X);
+    tensor_free(bias);
+    tensor_free(scale);
+}
+
+static tg_tensor_t* bias_add_with_threads(tg_tensor_t* X, tg_tensor_t* bias, size_t n_threads) {
+    tensor_set_num_threads(n_threads);
+    memset(bias->grads, 0, bias->n_elements * sizeof(tg_value_t));
+    tg_tensor_t* Y = tensor_el_add(X, bias);
+    UNWRAP(tensor_backward_pass(Y));
+    return Y;
+}
+
+void test_broadcast_threads_match_serial(void) {
+    tg_tensor_t* X = NULL;
+    tg_tensor_t* bias = NULL;
+    TENSOR_CREATE(&X, 300, 1000);
+    TENSOR_CREATE(&bias, 1000);
+    tensor_set_requires_grad(X, false);
+    fill_pattern(X, 4);
+    fill_pattern(bias, 5);
+    UNWRAP(tensor_grads_ensure(bias));
+
+    tg_tensor_t* serial = bias_add_with_threads(X, bias, 1);
+    tg_value_t serial_grad = bias->grads[999];
+    tg_tensor_t* threaded = bias_add_with_threads(X, bias, 4);
+    TEST_ASSERT_EQUAL_MEMORY(serial->vals, threaded->vals, serial->n_elements * sizeof(tg_value_t));
+    TEST_ASSERT_EQUAL_FLOAT(300.0f, bias->grads[999]);
+    TEST_ASSERT_EQUAL_FLOAT(serial_grad, bias->grads[999]);
+    tensor_set_num_threads(0);
+
+    tensor_free(serial);
+    tensor_free(threaded);
+    tensor_free(X);
+    tensor_free(bias);
+}
+
+void test_views_share_values(void) {
+    tg_tensor_t* X = NULL;
+    TENSOR_CREATE_RANGE(&X, 0.0f, 1.0f, 2, 3);
+    tensor_set_requires_grad(X, false);
+
+    size_t dims[] = {3, 2};
+    tg_tensor_t* R = tensor_reshape(X, dims, 2);
+    TEST_ASSERT_TRUE(tensor_is_contiguous(R));
+    TEST_ASSERT_EQUAL_PTR(X->vals, R->vals);
+
+    // T[i][j] = X[j][i], read through strides and packed by tensor_contiguous.
+    tg_tensor_t* T = tensor_transpose(X, 0, 1);
+    TEST_ASSERT_FALSE(tensor_is_contiguous(T));
+    tg_tensor_t* Tc = tensor_contiguous(T);
+    float expected_t[] = {0, 3, 1, 4, 2, 5};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected_t, Tc->vals, 6);
+
+    // Through the packing path of matmul: T·X = XᵀX.
+    tg_tensor_t* G = tensor_matmul(T, X);
+    TEST_ASSERT_EQUAL_FLOAT(0 * 0 + 3 * 3, G->vals[0]);
+    TEST_ASSERT_EQUAL_FLOAT(1 * 2 + 4 * 5, G->vals[1 * 3 + 2]);
+
+    // Row sums of the transpose are column sums of X.
+    size_t axis_1[] = {1};
+    tg_tensor_t* row_sums = tensor_sum(T, axis_1, 1);
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, row_sums->vals[0]);
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, row_sums->vals[1]);
+    TEST_ASSERT_EQUAL_FLOAT(7.0f, row_sums->vals[2]);
+
+    // Writes through a slice land in X and invalidate saved copies of it.
+    tg_tensor_t* S = tensor_slice(X, 1, 1, 3);
+    TEST_ASSERT_EQUAL(2, S->shape.dimensions[1]);
+    size_t version = tensor_version(X);
+    UNWRAP(tensor_scalar_add(S, 10.0f));
+    float expected_x[] = {0, 11, 12, 3, 14, 15};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected_x, X->vals, 6);
+    TEST_ASSERT_EQUAL(version + 1, tensor_version(X));
+
+    // Elementwise ops mix views and dense tensors.
+    tg_tensor_t* S0 = tensor_slice(X, 1, 0, 2);
+    tg_tensor_t* D = tensor_el_sub(S, S0);
+    float expected_d[] = {11, 1, 11, 1};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected_d, D->vals, 4);
+
+    // In place between views of X: interleaved columns that share no
+    // element, and a view with itself.
+    tg_tensor_t* first = tensor_slice(X, 1, 0, 1);
+    tg_tensor_t* last = tensor_slice(X, 1, 2, 3);
+    UNWRAP(tensor_el_add_(first, last));
+    UNWRAP(tensor_el_add_(last, last));
+    float expected_inplace[] = {12, 11, 24, 18, 14, 30};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected_inplace, X->vals, 6);
+
+    tensor_free(last);
+    tensor_free(first);
+    tensor_free(D);
+    tensor_free(S0);
+    tensor_free(S);
+    tensor_free(row_sums);
+    tensor_free(G);
+    tensor_free(Tc);
+    tensor_free(T);
+    tensor_free(R);
+    tensor_free(X);
+}
+
+void test_view_backward_reaches_base(void) {
+    tg_tensor_t* X = NULL;
+    TENSOR_CREATE(&X, 3, 4);
+    fill_pattern(X, 6);
+
+    // L = sum(Tᵀ-slice ⊙ Tᵀ-slice): dL/dX = 2X on columns 1..2, 0 elsewhere.
+    tg_tensor_t* T = tensor_slice(tensor_transpose(X, 0, 1), 0, 1, 3);
+    tg_tensor_t* L = tensor_sum(tensor_el_mul(T, T), NULL, 0);
+    UNWRAP(tensor_backward_pass(L));
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            float expected = j == 1 || j == 2 ? 2.0f * X->vals[i * 4 + j] : 0.0f;
+            TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected, X->grads[i * 4 + j]);
+        }
+    }
+    tensor_free_recursive(L);
+
+    // Through a packed copy and a reshape, on a tape.
+    memset(X->grads, 0, X->n_elements * sizeof(tg_value_t));
+    tg_tape_t tape;
+    UNWRAP(tensor_tape_init(&tape, 4));
+    tensor_tape_begin(&tape);
+    size_t flat[] = {12};
+    tg_tensor_t* F = tensor_reshape(tensor_contiguous(tensor_transpose(X, 0, 1)), flat, 1);
+    tg_tensor_t* M = tensor_mean(tensor_relu(F), NULL, 0);
+    tensor_tape_end();
+    UNWRAP(tensor_tape_backward(&tape, M));
+    for (size_t i = 0; i < 12; i++) {
+        TEST_ASSERT_EQUAL_FLOAT(X->vals[i] > 0 ? 1.0f / 12.0f : 0.0f, X->grads[i]);
+    }
+    tensor_tape_free(&tape);
+    tensor_free(X);
+}
+
+void test_storage_shared_between_tensors(void) {
+    // External memory, wrapped without a copy.
+    tg_value_t* buffer = malloc(6 * sizeof(tg_value_t));
+    for (size_t i = 0; i < 6; i++) { buffer[i] = (float)i; }
+    tg_storage_t* storage = NULL;
+    UNWRAP(tensor_storage_wrap(buffer, 6, true, &storage));
+
+    tg_tensor_t* W = NULL;
+    tg_tensor_t* tail = NULL;
+    size_t dims[] = {2, 2};
+    size_t tail_dims[] = {2};
+    UNWRAP(tensor_init_from_storage(storage, 0, dims, 2, &W));
+    UNWRAP(tensor_init_from_storage(storage, 4, tail_dims, 1, &tail));
+    tensor_storage_release(storage);
+    TEST_ASSERT_EQUAL_PTR(buffer, W->vals);
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, tail->vals[1]);
+
+    // Writes through one tensor are seen by the other and bump the shared version.
+    TENSOR_NO_GRAD(UNWRAP(tensor_scalar_mul(tail, 2.0f)));
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, buffer[5]);
+    TEST_ASSERT_EQUAL(tensor_version(W), tensor_version(tail));
+    tensor_free(W);
+    tensor_free(tail);
+
+    // A view keeps its base's storage alive, and an in-place write to the
+    // base invalidates a product that saved the view.
+    tg_tensor_t* X = NULL;
+    TENSOR_CREATE_RANGE(&X, 1.0f, 1.0f, 2, 3);
+    tg_tensor_t* T = tensor_transpose(X, 0, 1);
+    tg_tensor_t* Y = tensor_el_mul(T, T);
+    TENSOR_NO_GRAD(UNWRAP(tensor_scalar_add(X, 1.0f)));
+    TEST_ASSERT_EQUAL(ERR_SAVED_TENSOR_MODIFIED, tensor_backward_pass(Y));
+    tensor_free(Y);
+    tensor_free(T);
+
+    tensor_set_requires_grad(X, false);
+    T = tensor_transpose(X, 0, 1);
+    tensor_free(X);
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, T->vals[0]);
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, T->vals[T->shape.strides[1]]);
+    tensor_free(T);
+}
+
+// X[b][i][j] for a (2, 300, 270) X.
+static tg_value_t permuted_at(const tg_tensor_t* X, size_t b, size_t i, size_t j) {
+    return X->vals[(b * 300 + i) * 270 + j];
+}
+
+void test_strided_ops_match_contiguous(void) {
+    tg_tensor_t* X = NULL;
+    tg_tensor_t* Y = NULL;
+    tg_tensor_t* bias = NULL;
+    TENSOR_CREATE(&X, 2, 300, 270);
+    TENSOR_CREATE(&Y, 2, 270, 300);
+    TENSOR_CREATE(&bias, 300);
+    tensor_set_requires_grad(Y, false);
+    tensor_set_requires_grad(bias, false);
+    fill_pattern(X, 7);
+    fill_pattern(Y, 8);
+    fill_pattern(bias, 9);
+
+    // P is strided along its last axis and contiguous along the one before,
+    // so it is packed in tiles; neither axis is a multiple of the tile.
+    size_t perm[] = {0, 2, 1};
+    tg_tensor_t* P = tensor_permute(X, perm);
+    tg_tensor_t* Pc = tensor_contiguous(P);
+    for (size_t b = 0; b < 2; b++) {
+        for (size_t j = 0; j < 270; j += 13) {
+            for (size_t i = 0; i < 300; i += 7) {
+                TEST_ASSERT_EQUAL_FLOAT(permuted_at(X, b, i, j), Pc->vals[(b * 270 + j) * 300 + i]);
+            }
+        }
+    }
+
+    for (size_t n_threads = 1; n_threads <= 4; n_threads += 3) {
+        tensor_set_num_threads(n_threads);
+        tg_tensor_t* sum = tensor_el_add(P, Y);
+        tg_tensor_t* expected_sum = tensor_el_add(Pc, Y);
+        TEST_ASSERT_EQUAL_MEMORY(expected_sum->vals, sum->vals, sum->n_elements * sizeof(tg_value_t));
+        tg_tensor_t* biased = tensor_el_mul(P, bias);
+        tg_tensor_t* expected_biased = tensor_el_mul(Pc, bias);
+        TEST_ASSERT_EQUAL_MEMORY(expected_biased->vals, biased->vals, biased->n_elements * sizeof(tg_value_t));
+
+        // A slice of the permutation: strided, offset and not mergeable.
+        tg_tensor_t* S = tensor_slice(P, 2, 5, 290);
+        tg_tensor_t* Sc = tensor_contiguous(S);
+        TEST_ASSERT_EQUAL_FLOAT(permuted_at(X, 1, 289, 269), Sc->vals[Sc->n_elements - 1]);
+        TEST_ASSERT_EQUAL_FLOAT(permuted_at(X, 0, 5, 1), Sc->vals[285]);
+
+        // Reductions over the view, without packing it first.
+        size_t axes[] = {0, 2};
+        tg_tensor_t* reduced = tensor_sum(P, axes, 2);
+        tg_tensor_t* expected_reduced = tensor_sum(Pc, axes, 2);
+        for (size_t j = 0; j < 270; j++) {
+            TEST_ASSERT_FLOAT_WITHIN(1e-3f, expected_reduced->vals[j], reduced->vals[j]);
+        }
+
+        tensor_free(expected_reduced);
+        tensor_free(reduced);
+        tensor_free(Sc);
+        tensor_free(S);
+        tensor_free(expected_biased);
+        tensor_free(biased);
+        tensor_free(expected_sum);
+        tensor_free(sum);
+    }
+    tensor_set_num_threads(0);
+
+    // dL/dX for L = sum(P ⊙ Y) is Y read back through the permutation.
+    tg_tensor_t* L = tensor_sum(tensor_el_mul(P, Y), NULL, 0);
+    UNWRAP(tensor_backward_pass(L));
+    for (size_t b = 0; b < 2; b++) {
+        for (size_t i = 0; i < 300; i += 11) {
+            for (size_t j = 0; j < 270; j += 3) {
+                TEST_ASSERT_EQUAL_FLOAT(Y->vals[(b * 270 + j) * 300 + i], X->grads[(b * 300 + i) * 270 + j]);
+            }
+        }
+    }
+
+    tensor_free_recursive(L);
+    tensor_free(Pc);
+    tensor_free(X);
+    tensor_free(Y);
+    tensor_free(bias);
+}
+
+void test_arena_views_hold_no_storage_reference(void) {
+    tg_tensor_t* W = NULL;
+    TENSOR_CREATE_RANGE(&W, 1.0f, 1.0f, 2, 3);
+    tg_arena_t arena;
+    UNWRAP(tensor_arena_init(&arena, 1024));
+
+    // A step that transposes a weight must leave its storage as it was.
+    for (size_t step = 0; step < 3; step++) {
+        tensor_arena_begin(&arena);
+        tg_tensor_t* T = tensor_transpose(W, 0, 1);
+        tg_tensor_t* L = tensor_sum(tensor_el_mul(T, T), NULL, 0);
+        tensor_arena_end();
+
+        TEST_ASSERT_EQUAL(TG_ALLOC_ARENA, T->alloc);
+        TEST_ASSERT_EQUAL_PTR(W->storage, T->storage);
+        UNWRAP(tensor_backward_pass(L));
+        TEST_ASSERT_EQUAL_FLOAT(2.0f * 6.0f * (float)(step + 1), W->grads[5]);
+        tensor_arena_reset(&arena);
+        TEST_ASSERT_EQUAL(1, W->storage->ref_count);
+        TEST_ASSERT_EQUAL(1, W->ref_count);
+    }
+
+    tensor_arena_free(&arena);
+    tensor_free(W);
+}
+
+static bool is_aligned(const void* ptr) {
+    return (uintptr_t)ptr % TG_ALIGNMENT == 0;
+}
+
+// Odd sizes and high ranks move the end of the header and of vals around;
+// every allocator must still hand out aligned vals and grads.
+static void check_buffers_aligned(void) {
+    size_t shapes[][5] = { {1, 1, 1, 1, 1}, {3, 1, 1, 1, 1}, {7, 5, 1, 1, 1}, {2, 3, 1, 5, 7} };
+    size_t ranks[] = {1, 1, 2, 5};
+    for (size_t i = 0; i < 4; i++) {
+        tg_tensor_t* A = NULL;
+        tg_tensor_t* B = NULL;
+        UNWRAP(tensor_init(shapes[i], ranks[i], &A));
+        UNWRAP(tensor_init(shapes[i], ranks[i], &B));
+        tg_tensor_t* C = tensor_el_add(A, B);
+        UNWRAP(tensor_backward_pass(C));
+        TEST_ASSERT_TRUE(is_aligned(A->vals));
+        TEST_ASSERT_TRUE(is_aligned(B->vals));
+        TEST_ASSERT_TRUE(is_aligned(C->vals));
+        TEST_ASSERT_TRUE(is_aligned(A->grads));
+        TEST_ASSERT_TRUE(is_aligned(C->grads));
+        TEST_ASSERT_TRUE(is_aligned(A));
+        if (C->alloc != TG_ALLOC_ARENA) {
+            tensor_free(C);
+            tensor_free(A);
+            tensor_free(B);
+        }
+    }
+}
+
+void test_buffers_aligned_in_every_allocator(void) {
+    check_buffers_aligned();
+
+    tg_arena_t arena;
+    UNWRAP(tensor_arena_init(&arena, 1 << 12));
+    tensor_arena_begin(&arena);
+    check_buffers_aligned();
+    tensor_arena_end();
+    tensor_arena_free(&arena);
+
+    tg_pool_t pool;
+    tensor_pool_init(&pool, true);
+    tensor_pool_begin(&pool);
+    check_buffers_aligned();
+    check_buffers_aligned();
+    tensor_pool_end();
+    tensor_pool_free(&pool);
+}
+
 int main(void) {
     UNITY_BEGIN();
     RUN_TEST(test_tensor_init_creates_tensor);
@@ -406,6 +1948,43 @@ int main(void) {
     RUN_TEST(test_backward_el_sub);
     RUN_TEST(test_backward_el_mul);
     RUN_TEST(test_backward_el_div);
+    RUN_TEST(test_backward_pass_shared_subgraph);
+    RUN_TEST(test_graph_topo_order_visits_each_node_once);
+    RUN_TEST(test_backward_and_free_deep_chain);
+    RUN_TEST(test_graph_scratch_freed_at_thread_exit);
+    RUN_TEST(test_tape_backward_matches_graph);
+    RUN_TEST(test_no_grad_skips_graph_and_grads);
+    RUN_TEST(test_arena_step_reuses_memory);
+    RUN_TEST(test_pool_recycles_blocks);
+    RUN_TEST(test_tensor_high_rank_shape);
+    RUN_TEST(test_requires_grad_controls_grad_storage);
+    RUN_TEST(test_inplace_ops_bump_version);
+    RUN_TEST(test_inplace_ops_reject_graph_tensors);
+    RUN_TEST(test_backward_detects_modified_saved_input);
+    RUN_TEST(test_lazy_chain_matches_eager);
+    RUN_TEST(test_simd_kernels_match_scalar);
+    RUN_TEST(test_simd_scalar_and_unary_kernels);
+    RUN_TEST(test_dot_product_long_vectors);
+    RUN_TEST(test_matmul_small);
+    RUN_TEST(test_matmul_blocked_matches_reference);
+    RUN_TEST(test_matmul_threads_match_serial);
+    RUN_TEST(test_matmul_survives_thread_count_changes);
+    RUN_TEST(test_batched_matmul);
+    RUN_TEST(test_matmul_unit_dims);
+    RUN_TEST(test_activations_match_libm);
+    RUN_TEST(test_activation_backward);
+    RUN_TEST(test_softmax_cross_entropy);
+    RUN_TEST(test_softmax_cross_entropy_rejects_bad_targets);
+    RUN_TEST(test_sum_mean_axes);
+    RUN_TEST(test_sum_threads_match_serial);
+    RUN_TEST(test_broadcast_el_ops);
+    RUN_TEST(test_broadcast_threads_match_serial);
+    RUN_TEST(test_views_share_values);
+    RUN_TEST(test_view_backward_reaches_base);
+    RUN_TEST(test_storage_shared_between_tensors);
+    RUN_TEST(test_arena_views_hold_no_storage_reference);
+    RUN_TEST(test_buffers_aligned_in_every_allocator);
+    RUN_TEST(test_strided_ops_match_contiguous);
 
     return UNITY_END();
 }
@@ -5,11 +5,27 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <float.h>
 #include <math.h>
 #include <string.h>
 
+// Define TG_NO_THREADS to build without pthreads; parallel kernels then run
+// on the calling thread.
+#ifndef TG_NO_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TG_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
 
 // =======================================================
 // DEFINITIONS [START]
@@ -20,6 +36,10 @@
 #define ERR_UNKNOWN 1
 #define ERR_MEMORY_ALLOCATION 2
 #define ERR_INVALID_BACKWARDS_OP 3
+#define ERR_SAVED_TENSOR_MODIFIED 4
+#define ERR_UNSUPPORTED_ISA 5
+#define ERR_INPLACE_REQUIRES_GRAD 6
+#define ERR_INVALID_TARGET 7
 
 #define TODO() assert(false && "TODO") 
 #define UNREACHABLE() assert(false && "UNREACHABLE") 
@@ -36,43 +56,391 @@ typedef float tg_value_t;
 typedef int tg_err_t;
 
 
+// Shapes up to this rank keep their dimensions and strides inline; higher
+// ranks point at storage placed in the owning tensor's allocation (or on the
+// heap for standalone shapes, see tensor_shape_free).
+#ifndef TG_SHAPE_INLINE_DIMS
+#define TG_SHAPE_INLINE_DIMS 4
+#endif
+
+#define TG_MAX_INPUT_TENSORS 2
+
+// Every tensor block, value buffer and gradient buffer starts on a multiple
+// of this many bytes and is padded to one, so vector loads on them are
+// aligned and no two tensors share a cache line. Any power of two from
+// alignof(max_align_t) up to the page size.
+#ifndef TG_ALIGNMENT
+#define TG_ALIGNMENT 64
+#endif
+static_assert((TG_ALIGNMENT & (TG_ALIGNMENT - 1)) == 0, "TG_ALIGNMENT must be a power of two");
+static_assert(TG_ALIGNMENT >= alignof(max_align_t) && TG_ALIGNMENT <= 4096,
+              "TG_ALIGNMENT must be between alignof(max_align_t) and the page size");
+
+#define TG_ALIGN_UP(n, align) (((n) + (align) - 1) & ~((size_t)(align) - 1))
+
+// `dimensions` and `strides` may point into the struct itself, so shapes
+// must not be copied by value.
 typedef struct {
     size_t n_dimensions;
     size_t* dimensions;
     size_t* strides;
+
+    size_t inline_dimensions[TG_SHAPE_INLINE_DIMS];
+    size_t inline_strides[TG_SHAPE_INLINE_DIMS];
 } tg_tensor_shape_t;
 
 typedef struct tg_tensor_t tg_tensor_t;
+typedef struct tg_storage_t tg_storage_t;
+typedef struct tg_arena_t tg_arena_t;
+
+enum tg_backward_op {
+    TG_BOP_EL_ADD,
+    TG_BOP_EL_SUB,
+    TG_BOP_EL_MUL,
+    TG_BOP_EL_DIV,
+    TG_BOP_MAT_MUL,
+    TG_BOP_SUM_REDUCTION,
+    TG_BOP_MEAN_REDUCTION,
+    TG_BOP_FUSED_ELEMENTWISE,
+    TG_BOP_RELU,
+    TG_BOP_SIGMOID,
+    TG_BOP_TANH,
+    TG_BOP_EXP,
+    TG_BOP_LOG,
+    TG_BOP_SOFTMAX_CROSS_ENTROPY,
+    TG_BOP_VIEW,
+    TG_BOP_COPY,
+};
+
+// Lazy elementwise expression: a small program over the leaf tensors it
+// reads. Operands with TG_FUSED_LEAF set index `leaves`, the others index
+// earlier entries of `ops`; the last op produces the tensor's value.
+#define TG_FUSED_MAX_LEAVES 8
+#define TG_FUSED_MAX_OPS 16
+#define TG_FUSED_LEAF 0x80
+#define TG_FUSED_BLOCK 128
+
+typedef struct {
+    enum tg_backward_op op;
+    uint8_t lhs;
+    uint8_t rhs;
+} tg_fused_op_t;
+
+typedef struct {
+    tg_tensor_t* leaves[TG_FUSED_MAX_LEAVES];
+    size_t leaf_versions[TG_FUSED_MAX_LEAVES];
+    size_t n_leaves;
+
+    tg_fused_op_t ops[TG_FUSED_MAX_OPS];
+    size_t n_ops;
+} tg_fused_expr_t;
+
+// Instruction sets the elementwise kernels are specialized for, in order of
+// preference. TG_ISA_SCALAR is the portable fallback.
+typedef enum {
+    TG_ISA_SCALAR = 0,
+    TG_ISA_SSE2,
+    TG_ISA_AVX2,
+    TG_ISA_AVX512,
+} tg_isa_t;
+
+// One set of elementwise kernels per instruction set. The forward kernels
+// write out[i] = x[i] op y[i] (out may alias x or y); the grad kernels
+// accumulate into dst.
+typedef struct {
+    tg_isa_t isa;
+    void (*add)(const tg_value_t* x, const tg_value_t* y, tg_value_t* out, size_t n);
+    void (*sub)(const tg_value_t* x, const tg_value_t* y, tg_value_t* out, size_t n);
+    void (*mul)(const tg_value_t* x, const tg_value_t* y, tg_value_t* out, size_t n);
+    void (*div)(const tg_value_t* x, const tg_value_t* y, tg_value_t* out, size_t n);
+
+    // dst += d, dst -= d, dst += d * y, dst += d * (1/y), dst += d * (-x / y²)
+    void (*grad_acc)(tg_value_t* dst, const tg_value_t* d, size_t n);
+    void (*grad_acc_neg)(tg_value_t* dst, const tg_value_t* d, size_t n);
+    void (*grad_mul)(tg_value_t* dst, const tg_value_t* d, const tg_value_t* y, size_t n);
+    void (*grad_div_lhs)(tg_value_t* dst, const tg_value_t* d, const tg_value_t* y, size_t n);
+    void (*grad_div_rhs)(tg_value_t* dst, const tg_value_t* d, const tg_value_t* x, const tg_value_t* y, size_t n);
+
+    // out[i] = x[i] op s; division multiplies by the reciprocal instead.
+    void (*scalar_add)(const tg_value_t* x, tg_value_t s, tg_value_t* out, size_t n);
+    void (*scalar_sub)(const tg_value_t* x, tg_value_t s, tg_value_t* out, size_t n);
+    void (*scalar_mul)(const tg_value_t* x, tg_value_t s, tg_value_t* out, size_t n);
+
+    // out[i] = f(x[i])
+    void (*sqrt)(const tg_value_t* x, tg_value_t* out, size_t n);
+    void (*abs)(const tg_value_t* x, tg_value_t* out, size_t n);
+
+    // Activations, out[i] = f(x[i]), and their grads: dst += d * f'(x),
+    // computed from the input for relu and from the output y otherwise.
+    void (*relu)(const tg_value_t* x, tg_value_t* out, size_t n);
+    void (*exp)(const tg_value_t* x, tg_value_t* out, size_t n);
+    void (*log)(const tg_value_t* x, tg_value_t* out, size_t n);
+    void (*tanh)(const tg_value_t* x, tg_value_t* out, size_t n);
+    void (*sigmoid)(const tg_value_t* x, tg_value_t* out, size_t n);
+    void (*grad_relu)(tg_value_t* dst, const tg_value_t* d, const tg_value_t* x, size_t n);
+    void (*grad_tanh)(tg_value_t* dst, const tg_value_t* d, const tg_value_t* y, size_t n);
+    void (*grad_sigmoid)(tg_value_t* dst, const tg_value_t* d, const tg_value_t* y, size_t n);
+
+    // log(sum(exp(x[i]))) in a single pass, without overflow.
+    tg_value_t (*logsumexp)(const tg_value_t* x, size_t n);
+    // dst[i] += scale * exp(x[i] - shift)
+    void (*grad_softmax)(tg_value_t* dst, const tg_value_t* x, tg_value_t shift, tg_value_t scale, size_t n);
+
+    // y[i] += alpha * x[i]
+    void (*axpy)(tg_value_t* y, tg_value_t alpha, const tg_value_t* x, size_t n);
+
+    // sum(x[i]) and sum(x[i] * y[i]) for one block of at most TG_DOT_BLOCK elements.
+    tg_value_t (*sum)(const tg_value_t* x, size_t n);
+    tg_value_t (*dot)(const tg_value_t* x, const tg_value_t* y, size_t n);
+
+    // GEMM micro-kernel: tile = a * b for a packed TG_GEMM_MR x kc sliver of
+    // A and a packed kc x TG_GEMM_NR sliver of B (see tensor_gemm).
+    void (*gemm_tile)(size_t kc, const tg_value_t* a, const tg_value_t* b, tg_value_t* tile);
+} tg_simd_kernels_t;
+
+// Dot products sum fixed-size blocks with independent SIMD accumulators and
+// combine the block sums pairwise in double precision, so the rounding error
+// grows with log(n / TG_DOT_BLOCK) instead of n.
+#ifndef TG_DOT_BLOCK
+#define TG_DOT_BLOCK 1024
+#endif
+
+// logsumexp takes each chunk's max while the chunk is still in L1, so the
+// online max/sum needs one exp per element and a single sweep from memory.
+// Must be a multiple of the widest vector (16).
+#ifndef TG_LSE_CHUNK
+#define TG_LSE_CHUNK 256
+#endif
+
+// GEMM register tile and cache blocking: a KC x NR sliver of B stays in L1
+// while the micro-kernel sweeps it, an MC x KC block of A is sized for L2
+// and a KC x NC panel of B for L3.
+#define TG_GEMM_MR 6
+#define TG_GEMM_NR 16
+// MC and NC must be multiples of MR and NR.
+#ifndef TG_GEMM_MC
+#define TG_GEMM_MC 96
+#endif
+#ifndef TG_GEMM_KC
+#define TG_GEMM_KC 256
+#endif
+#ifndef TG_GEMM_NC
+#define TG_GEMM_NC 2048
+#endif
+
+#ifndef TG_NO_THREADS
+// Worker threads blocked on `work_ready` until `generation` changes, then
+// pulling task indices from `next_task`. `submit` serializes jobs.
+typedef struct {
+    pthread_mutex_t submit;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    pthread_t* threads;
+    size_t n_workers;
+    size_t generation;
+    bool shutdown;
+
+    void (*fn)(void* ctx, size_t task, size_t worker);
+    void* ctx;
+    size_t n_tasks;
+    // Workers at or past this index sit the current job out.
+    size_t n_threads;
+    atomic_size_t next_task;
+    size_t n_active;
+} tg_thread_pool_t;
+#endif
+
+// Geometry of a (possibly batched) matmul; a zero stride marks the operand
+// that is shared across the batch.
+typedef struct {
+    size_t batch, M, K, N;
+    size_t a_stride, b_stride;
+} tg_matmul_dims_t;
+
+// GEMMs with fewer multiply-adds than this stay on the calling thread.
+#ifndef TG_GEMM_PARALLEL_MIN_MACS
+#define TG_GEMM_PARALLEL_MIN_MACS (64 * 64 * 64)
+#endif
+
+// Where a tensor (header, buffers, shape and graph edges) was allocated.
+typedef enum {
+    TG_ALLOC_HEAP = 0,
+    TG_ALLOC_ARENA,
+    TG_ALLOC_POOL,
+} tg_alloc_kind_t;
+
+// Reference-counted buffer of values that tensors point into. A tensor and
+// its views share one storage, which lives until its last reference is
+// released. Storage created with a tensor sits in the tensor's own block;
+// tensor_storage_wrap puts external memory (mmap'd weights, I/O buffers)
+// behind a tensor without copying it.
+struct tg_storage_t {
+    tg_value_t* data;
+    size_t n_elements;
+    size_t ref_count;
+
+    // Bumped by every in-place write to data, through any tensor sharing
+    // it. Graph nodes remember the versions of their inputs so backward
+    // can detect a saved input that was overwritten after the forward pass.
+    size_t version;
+
+    // Whether data is a separate malloc'd buffer freed with the storage.
+    // Borrowed memory must outlive every tensor pointing into it.
+    bool owns_data;
+    tg_alloc_kind_t alloc;
+    // Allocation holding this struct: the creating tensor's block, which
+    // then stays alive until both the tensor and the storage are released.
+    void* block;
+};
 
 struct tg_tensor_t {
     size_t n_elements;
     tg_tensor_shape_t shape;
 
+    // vals is storage->data + storage_offset, read with shape's strides.
     tg_value_t* vals;
+    tg_storage_t* storage;
+    size_t storage_offset;
+    // Set for views, to route their gradient: grads stay a contiguous
+    // buffer of the view's shape, accumulated into view_base's grads by
+    // backward. Views never chain; view_base is the tensor they view.
+    tg_tensor_t* view_base;
+    // Allocated on first accumulation, and only if requires_grad is set.
     tg_value_t* grads;
+    bool requires_grad;
     tg_err_t (*backward)(tg_tensor_t* self);
 
     tg_tensor_t** input_tensors;
     size_t n_input_tensors;
     size_t ref_count;
+    tg_tensor_t* inline_inputs[TG_MAX_INPUT_TENSORS];
+
+    // Storage versions of the inputs when this node was created.
+    size_t saved_versions[TG_MAX_INPUT_TENSORS];
+    enum tg_backward_op op;
+
+    // Set for outputs of lazy elementwise ops: vals are only computed by
+    // tensor_realize, one fused loop over the expression's leaves.
+    tg_fused_expr_t* lazy_expr;
+    bool pending;
+
+    // Traversal epoch this node was last visited in, used to build the
+    // topological order for the backward pass without a separate set.
+    size_t graph_mark;
+
+    tg_alloc_kind_t alloc;
+    // Arena the tensor lives in, so lazily allocated grads can follow it
+    // after the arena is no longer active.
+    tg_arena_t* arena;
 };
 
-enum tg_backward_op {
-    TG_BOP_EL_ADD,
-    TG_BOP_EL_SUB,
-    TG_BOP_EL_MUL,
-    TG_BOP_EL_DIV,
-    TG_BOP_MAT_MUL,
-    TG_BOP_SUM_REDUCTION,
-    TG_BOP_MEAN_REDUCTION,
+// Explicit worklist shared by every graph traversal (backward ordering and
+// recursive freeing), so arbitrarily deep graphs never recurse on the C
+// stack. The buffers are kept between calls and only grow, so repeated
+// training steps over the same graph do not allocate. Each thread has its
+// own scratch, freed when the thread exits (tensor_graph_scratch_release
+// frees it early); threads may run backward concurrently on disjoint graphs.
+typedef struct {
+    tg_tensor_t* tensor;
+    size_t next_input;
+} tg_graph_frame_t;
+
+typedef struct {
+    tg_graph_frame_t* frames;
+    size_t frames_capacity;
+
+    tg_tensor_t** order;
+    size_t n_order;
+    size_t order_capacity;
+} tg_graph_scratch_t;
+
+// Bump allocator for the intermediates of one training step. While an arena
+// is active, tensor_init, tensor_shape_init and tensor_create_graph carve
+// their memory out of it instead of calling calloc, and the whole step is
+// released at once by tensor_arena_reset(). Memory is a chain of chunks that
+// is kept across resets, so a steady-state loop stops allocating entirely.
+//
+// Arena tensors never take references on their inputs, and tensor_free /
+// tensor_free_recursive leave them alone: long-lived parameters created
+// outside the arena keep their ref counts across steps.
+typedef struct tg_arena_chunk_t tg_arena_chunk_t;
+
+struct tg_arena_chunk_t {
+    tg_arena_chunk_t* next;
+    size_t capacity;
+    size_t used;
 };
 
+struct tg_arena_t {
+    tg_arena_chunk_t* head;
+    tg_arena_chunk_t* current;
+    size_t chunk_size;
+};
+
+// Recycling allocator for tensors that outlive a step. While a pool is
+// active (and no arena is), tensor allocations are rounded up to a
+// power-of-two size class and freed blocks are pushed onto that class's free
+// list instead of going back to free(), so loops that keep allocating the
+// same shapes are served from the lists.
+//
+// With `lazy_zero` set, recycled blocks handed to op outputs are not cleared
+// where the op is about to overwrite them anyway.
+//
+// A pool is not thread-safe: free tensors on the thread that owns the pool,
+// and only free the pool once none of its tensors are alive.
+#define TG_POOL_MIN_BLOCK 64
+#define TG_POOL_N_CLASSES 32
+
+typedef struct {
+    void* free_lists[TG_POOL_N_CLASSES];
+    bool lazy_zero;
+
+    size_t hits;
+    size_t misses;
+} tg_pool_t;
+
+// Tape (Wengert list) representation of the graph. While a tape is active,
+// forward ops append one fixed-size record instead of wiring up
+// `input_tensors`, and the backward pass walks the records in reverse.
+// The tape owns every output it records; they are released together by
+// tensor_tape_reset() / tensor_tape_free().
+typedef struct {
+    enum tg_backward_op op;
+    tg_tensor_t* inputs[2];
+    size_t input_versions[2];
+    tg_tensor_t* output;
+} tg_tape_record_t;
+
+typedef struct {
+    tg_tape_record_t* records;
+    size_t n_records;
+    size_t capacity;
+} tg_tape_t;
+
+
+// `kernel` names a scalar or unary entry of tg_simd_kernels_t.
+// Views that are not contiguous are walked through their strides.
+#define TENSOR_SCALAR_OP(tensor, scalar, kernel) \
+		do { \
+				UNWRAP(tensor_realize(tensor)); \
+				if (tensor_is_contiguous(tensor)) { \
+						tg_simd->kernel((tensor)->vals, (scalar), (tensor)->vals, (tensor)->n_elements); \
+				} else { \
+						tensor_map_strided((tensor), NULL, tg_simd->kernel, (scalar)); \
+				} \
+				tensor_bump_version(tensor); \
+		} while (0)
 
-#define TENSOR_SCALAR_OP(tensor, scalar, op) \
+#define TENSOR_UNARY_OP(tensor, kernel) \
 		do { \
-				for (size_t i = 0; i < (tensor)->n_elements; i++) { \
-						(tensor)->vals[i] = (tensor)->vals[i] op (scalar); \
+				UNWRAP(tensor_realize(tensor)); \
+				if (tensor_is_contiguous(tensor)) { \
+						tg_simd->kernel((tensor)->vals, (tensor)->vals, (tensor)->n_elements); \
+				} else { \
+						tensor_map_strided((tensor), tg_simd->kernel, NULL, 0); \
 				} \
+				tensor_bump_version(tensor); \
 		} while (0)
 
 #define TENSOR_CREATE(tensor_ptr, ...) \
@@ -84,7 +452,7 @@ enum tg_backward_op {
 #define TENSOR_DESTROY(tensor) \
 		do { \
 				if (tensor) { \
-						free(tensor); \
+						tensor_free(tensor); \
 						tensor = NULL; \
 				} \
 		} while (0)
@@ -135,6 +503,8 @@ enum tg_backward_op {
 
 #define TENSOR_ASSERT_EQUAL(t1, t2) \
 		do { \
+				UNWRAP(tensor_realize(t1)); \
+				UNWRAP(tensor_realize(t2)); \
 				assert((t1)->n_elements == (t2)->n_elements); \
 				for (size_t i = 0; i < (t1)->n_elements; i++) { \
 						assert((t1)->vals[i] == (t2)->vals[i]); \
@@ -143,18 +513,76 @@ enum tg_backward_op {
 
 #define TENSOR_GRADS_SET(t, v) \
 		do { \
+				UNWRAP(tensor_grads_ensure(t)); \
 				for (size_t i = 0; i < t->n_elements; i++) { \
                      t->grads[i] = v; \
 				} \
 		} while (0)
 
 
+// Runs `code` with lazy elementwise fusion enabled on the calling thread.
+#define TENSOR_LAZY(code) \
+		do { \
+				tensor_lazy_begin(); \
+				code; \
+				tensor_lazy_end(); \
+		} while (0)
+
+// Runs `code` with gradient tracking disabled on the calling thread: tensors
+// created inside do not require grad and ops record no graph edges.
+#define TENSOR_NO_GRAD(code) \
+		do { \
+				tensor_no_grad_begin(); \
+				code; \
+				tensor_no_grad_end(); \
+		} while (0)
+
+
 #define TENSOR_PRINT(tensor) tensor_print(tensor)
 #define TENSOR_PRINT_GRADIENTS(tensor) tensor_print_grads(tensor)
 
 tg_err_t tensor_init(size_t dims[], size_t n_dims, tg_tensor_t** ptr);
+tg_err_t tensor_init_from_storage(tg_storage_t* storage, size_t offset, size_t dims[], size_t n_dims,
+                                  tg_tensor_t** ptr);
+tg_err_t tensor_storage_wrap(tg_value_t* data, size_t n_elements, bool owns_data, tg_storage_t** ptr);
+void tensor_storage_retain(tg_storage_t* storage);
+void tensor_storage_release(tg_storage_t* storage);
+size_t tensor_version(const tg_tensor_t* tensor);
 void tensor_free(tg_tensor_t* tensor);
+void tensor_set_requires_grad(tg_tensor_t* tensor, bool requires_grad);
+tg_err_t tensor_grads_ensure(tg_tensor_t* tensor);
 void tensor_free_recursive(tg_tensor_t* tensor);
+tg_err_t tensor_backward_pass(tg_tensor_t* tensor);
+tg_err_t tensor_graph_topo_order(tg_tensor_t* root, tg_tensor_t*** order, size_t* n_order);
+void tensor_graph_scratch_release(void);
+
+tg_err_t tensor_arena_init(tg_arena_t* arena, size_t chunk_size);
+void tensor_arena_begin(tg_arena_t* arena);
+void tensor_arena_end(void);
+void tensor_arena_reset(tg_arena_t* arena);
+void tensor_arena_free(tg_arena_t* arena);
+
+void tensor_pool_init(tg_pool_t* pool, bool lazy_zero);
+void tensor_pool_begin(tg_pool_t* pool);
+void tensor_pool_end(void);
+void tensor_pool_free(tg_pool_t* pool);
+
+void tensor_set_num_threads(size_t n_threads);
+size_t tensor_get_num_threads(void);
+void tensor_thread_pool_shutdown(void);
+
+tg_isa_t tensor_simd_isa(void);
+bool tensor_simd_supported(tg_isa_t isa);
+tg_err_t tensor_simd_select(tg_isa_t isa);
+
+void tensor_lazy_begin(void);
+void tensor_lazy_end(void);
+bool tensor_lazy_enabled(void);
+tg_err_t tensor_realize(tg_tensor_t* tensor);
+
+void tensor_no_grad_begin(void);
+void tensor_no_grad_end(void);
+bool tensor_grad_enabled(void);
 
 tg_err_t tensor_scalar_add(tg_tensor_t* tensor, tg_value_t scalar);
 tg_err_t tensor_scalar_sub(tg_tensor_t* tensor, tg_value_t scalar);
@@ -164,6 +592,7 @@ tg_err_t tensor_sqrt(tg_tensor_t* tensor);
 tg_err_t tensor_abs(tg_tensor_t* tensor);
 
 tg_value_t tensor_dot_product(tg_tensor_t* a, tg_tensor_t* b);
+double tensor_dot_product_f64(tg_tensor_t* a, tg_tensor_t* b);
 
 void tensor_print(tg_tensor_t* tensor);
 void tensor_print_grads(tg_tensor_t* tensor);
@@ -179,17 +608,47 @@ tg_tensor_t* tensor_el_add(tg_tensor_t* a, tg_tensor_t* b);
 tg_tensor_t* tensor_el_sub(tg_tensor_t* a, tg_tensor_t* b);
 tg_tensor_t* tensor_el_mul(tg_tensor_t* a, tg_tensor_t* b);
 tg_tensor_t* tensor_el_div(tg_tensor_t* a, tg_tensor_t* b);
+tg_tensor_t* tensor_matmul(tg_tensor_t* a, tg_tensor_t* b);
+tg_tensor_t* tensor_relu(tg_tensor_t* x);
+tg_tensor_t* tensor_sigmoid(tg_tensor_t* x);
+tg_tensor_t* tensor_tanh(tg_tensor_t* x);
+tg_tensor_t* tensor_exp(tg_tensor_t* x);
+tg_tensor_t* tensor_log(tg_tensor_t* x);
+tg_tensor_t* tensor_softmax_cross_entropy(tg_tensor_t* logits, tg_tensor_t* targets);
+tg_tensor_t* tensor_sum(tg_tensor_t* x, const size_t axes[], size_t n_axes);
+tg_tensor_t* tensor_mean(tg_tensor_t* x, const size_t axes[], size_t n_axes);
+bool tensor_is_contiguous(const tg_tensor_t* x);
+tg_tensor_t* tensor_reshape(tg_tensor_t* x, size_t dims[], size_t n_dims);
+tg_tensor_t* tensor_permute(tg_tensor_t* x, const size_t perm[]);
+tg_tensor_t* tensor_transpose(tg_tensor_t* x, size_t dim0, size_t dim1);
+tg_tensor_t* tensor_slice(tg_tensor_t* x, size_t axis, size_t start, size_t end);
+tg_tensor_t* tensor_contiguous(tg_tensor_t* x);
+tg_err_t tensor_el_add_(tg_tensor_t* a, tg_tensor_t* b);
+tg_err_t tensor_el_sub_(tg_tensor_t* a, tg_tensor_t* b);
+tg_err_t tensor_el_mul_(tg_tensor_t* a, tg_tensor_t* b);
+tg_err_t tensor_el_div_(tg_tensor_t* a, tg_tensor_t* b);
 tg_err_t tensor_backward_el_add(tg_tensor_t* tensor);
 tg_err_t tensor_backward_el_sub(tg_tensor_t* tensor);
 tg_err_t tensor_backward_el_mul(tg_tensor_t* tensor);
 tg_err_t tensor_backward_el_div(tg_tensor_t* tensor);
+tg_err_t tensor_backward_fused(tg_tensor_t* tensor);
+tg_err_t tensor_backward_mat_mul(tg_tensor_t* tensor);
+tg_err_t tensor_backward_unary(tg_tensor_t* tensor);
+tg_err_t tensor_backward_softmax_cross_entropy(tg_tensor_t* tensor);
+tg_err_t tensor_backward_reduction(tg_tensor_t* tensor);
 
-/*
-* tg_err_t tensor_backward_mat_mul(tg_tensor_t* tensor);
-*/
+tg_err_t tensor_tape_init(tg_tape_t* tape, size_t capacity);
+void tensor_tape_begin(tg_tape_t* tape);
+void tensor_tape_end(void);
+tg_err_t tensor_tape_record(tg_tape_t* tape, enum tg_backward_op op,
+                            tg_tensor_t* output, tg_tensor_t* a, tg_tensor_t* b);
+tg_err_t tensor_tape_backward(tg_tape_t* tape, tg_tensor_t* loss);
+void tensor_tape_reset(tg_tape_t* tape);
+void tensor_tape_free(tg_tape_t* tape);
 
 
 tg_err_t tensor_shape_init(size_t dims[], size_t n_dims, tg_tensor_shape_t* shape);
+void tensor_shape_free(tg_tensor_shape_t* shape);
 void tensor_shape_print(tg_tensor_shape_t* shape);
 
 // Utility functions
@@ -201,248 +660,3356 @@ size_t total_elements_for_dimensions(size_t dims[], size_t n_dims);
 // =======================================================
 
 
+static _Thread_local tg_graph_scratch_t tg_graph_scratch = {0};
+static _Thread_local tg_tape_t* tg_active_tape = NULL;
+static _Thread_local size_t tg_no_grad_depth = 0;
+static _Thread_local tg_arena_t* tg_active_arena = NULL;
+static _Thread_local tg_pool_t* tg_active_pool = NULL;
+static _Thread_local size_t tg_lazy_depth = 0;
+// Shared so that every traversal, on any thread, marks with a fresh epoch.
+static atomic_size_t tg_graph_epoch = 0;
+static atomic_size_t tg_num_threads = 0;
+static _Thread_local bool tg_in_parallel = false;
+static _Thread_local tg_value_t* tg_gemm_scratch = NULL;
+static _Thread_local size_t tg_gemm_scratch_size = 0;
+#ifndef TG_NO_THREADS
+static tg_thread_pool_t tg_thread_pool = {
+    .submit = PTHREAD_MUTEX_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .work_ready = PTHREAD_COND_INITIALIZER,
+    .work_done = PTHREAD_COND_INITIALIZER,
+};
+#endif
+
+static tg_err_t tensor_shape_init_with(size_t dims[], size_t n_dims, size_t* storage,
+                                       tg_tensor_shape_t* shape);
+static void* tensor_arena_alloc(tg_arena_t* arena, size_t size, bool zeroed);
+static void* tensor_pool_alloc(tg_pool_t* pool, size_t size, bool zeroed);
+static void tensor_pool_release(void* ptr);
+static tg_pool_t* tensor_pool_of(void* ptr);
+static tg_matmul_dims_t tensor_matmul_dims(tg_tensor_t* a, tg_tensor_t* b);
+static tg_err_t tensor_grad_softmax_cross_entropy(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B);
+static tg_err_t tensor_grad_sum(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B);
+static bool tensor_same_shape(const tg_tensor_t* a, const tg_tensor_t* b);
+static tg_err_t tensor_grad_el_broadcast(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B,
+                                         tg_value_t* dA, tg_value_t* dB, enum tg_backward_op op);
+static tg_err_t tensor_grad_mean(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B);
+static tg_err_t tensor_grad_view(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B);
+static tg_err_t tensor_grad_copy(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B);
+static bool tensor_flat_pair(const tg_tensor_t* a, const tg_tensor_t* b);
+static void tensor_dense_shape(const tg_tensor_t* x, size_t* storage, tg_tensor_shape_t* shape);
+static tg_err_t tensor_dense_vals(tg_tensor_t* x, const tg_value_t** vals, tg_value_t** scratch);
+static void tensor_strided_copy(tg_value_t* dst, const tg_tensor_shape_t* dst_shape,
+                                tg_value_t* src, const tg_tensor_shape_t* src_shape, size_t n_elements);
+static void tensor_map_strided(tg_tensor_t* x, void (*unary)(const tg_value_t*, tg_value_t*, size_t),
+                               void (*scalar_fn)(const tg_value_t*, tg_value_t, tg_value_t*, size_t),
+                               tg_value_t scalar);
+static void tensor_bump_version(tg_tensor_t* x);
+static tg_err_t tensor_check_saved_versions(enum tg_backward_op op,
+                                            tg_tensor_t* output,
+                                            tg_tensor_t* const inputs[],
+                                            const size_t versions[],
+                                            size_t n_inputs);
 
-tg_err_t tensor_init(size_t dims[], size_t n_dims, tg_tensor_t** ptr) {
+// Every allocation belonging to a tensor goes through these, so that a
+// tensor and all of its pieces always come from the same allocator.
+static tg_alloc_kind_t tensor_alloc_kind_current(void) {
+    if (tg_active_arena) { return TG_ALLOC_ARENA; }
+    if (tg_active_pool) { return TG_ALLOC_POOL; }
+    return TG_ALLOC_HEAP;
+}
+
+// Heap memory aligned and padded to TG_ALIGNMENT, released with free().
+static void* tensor_aligned_alloc(size_t size) {
+    return aligned_alloc(TG_ALIGNMENT, TG_ALIGN_UP(size ? size : 1, TG_ALIGNMENT));
+}
+
+static void* tensor_aligned_calloc(size_t size) {
+    void* ptr = tensor_aligned_alloc(size);
+    if (ptr) { memset(ptr, 0, size); }
+    return ptr;
+}
+
+// With `zeroed` false the contents are unspecified; callers must clear
+// whatever they do not overwrite.
+static void* tensor_alloc_block(tg_alloc_kind_t kind, size_t size, bool zeroed) {
+    switch (kind) {
+        case TG_ALLOC_HEAP:
+            return zeroed ? tensor_aligned_calloc(size) : tensor_aligned_alloc(size);
+        case TG_ALLOC_ARENA:
+            assert(tg_active_arena != NULL);
+            return tensor_arena_alloc(tg_active_arena, size, zeroed);
+        case TG_ALLOC_POOL:
+            assert(tg_active_pool != NULL);
+            return tensor_pool_alloc(tg_active_pool, size, zeroed);
+    }
+    UNREACHABLE();
+    return NULL;
+}
+
+static void tensor_release(tg_alloc_kind_t kind, void* ptr) {
+    if (!ptr) { return; }
+    switch (kind) {
+        case TG_ALLOC_HEAP:
+            free(ptr);
+            break;
+        case TG_ALLOC_ARENA:
+            break;
+        case TG_ALLOC_POOL:
+            tensor_pool_release(ptr);
+            break;
+    }
+}
+
+// Arena tensors hold no references to storage outside their own block, as
+// they hold none to their graph inputs: the arena is reset without
+// releasing anything, so such storage must outlive the step.
+static void tensor_attach_storage(tg_tensor_t* tensor, tg_storage_t* storage, size_t offset) {
+    if (tensor->alloc != TG_ALLOC_ARENA || storage->block == tensor) {
+        tensor_storage_retain(storage);
+    }
+    tensor->storage = storage;
+    tensor->storage_offset = offset;
+    tensor->vals = storage->data + offset;
+}
+
+// Shared by tensor_init, the op outputs and views. The tensor's block also
+// holds its storage unless `with_storage` is false, for headers that are
+// pointed into an existing storage afterwards. With `zero_vals` false the
+// value buffer may hold stale data, which is fine for ops that overwrite
+// all of it.
+static tg_err_t tensor_init_block(size_t dims[], size_t n_dims, bool with_storage,
+                                  bool zero_vals, tg_tensor_t** ptr) {
     assert(dims != NULL);
     assert(n_dims > 0);
 
-    size_t tensor_size = total_elements_for_dimensions(dims, n_dims) * sizeof(tg_value_t);
-    size_t total_size = (2 * tensor_size) + sizeof(tg_tensor_t);
+    // Layout: header | high-rank dims and strides | storage | pad | vals,
+    // with vals starting on a TG_ALIGNMENT boundary like the block itself.
+    size_t n_elements = total_elements_for_dimensions(dims, n_dims);
+    size_t shape_size = n_dims > TG_SHAPE_INLINE_DIMS ? 2 * n_dims * sizeof(size_t) : 0;
+    size_t storage_offset = sizeof(tg_tensor_t) + shape_size;
+    size_t buffers_offset = TG_ALIGN_UP(storage_offset + sizeof(tg_storage_t), TG_ALIGNMENT);
+    size_t total_size = with_storage ? buffers_offset + n_elements * sizeof(tg_value_t) : storage_offset;
 
-    tg_tensor_t* tensor = calloc(1, total_size);
+    tg_alloc_kind_t kind = tensor_alloc_kind_current();
+    tg_tensor_t* tensor = tensor_alloc_block(kind, total_size, zero_vals);
     if (!tensor) {return ERR_MEMORY_ALLOCATION; }
-    tensor_shape_init(dims, n_dims, &tensor->shape);
+    if (!zero_vals) {
+        memset(tensor, 0, sizeof(tg_tensor_t));
+    }
+    tensor->alloc = kind;
+    tensor->arena = kind == TG_ALLOC_ARENA ? tg_active_arena : NULL;
+    tensor_shape_init_with(dims, n_dims, shape_size ? (size_t*)(tensor+1) : NULL, &tensor->shape);
 
     tensor->ref_count = 1;
     tensor->n_elements = tensor_total_elements(tensor);
 
-    tensor->vals = (tg_value_t*)(tensor+1);
-    tensor->grads = (tg_value_t*)(tensor->vals + tensor->n_elements);
+    if (with_storage) {
+        tg_storage_t* storage = (tg_storage_t*)((unsigned char*)tensor + storage_offset);
+        *storage = (tg_storage_t){
+            .data = (tg_value_t*)((unsigned char*)tensor + buffers_offset),
+            .n_elements = n_elements,
+            .alloc = kind,
+            .block = tensor,
+        };
+        tensor_attach_storage(tensor, storage, 0);
+    }
+    tensor->grads = NULL;
+    tensor->requires_grad = tensor_grad_enabled();
 
     *ptr = tensor;
     return SUCCESS;
 }
 
+static tg_err_t tensor_init_with(size_t dims[], size_t n_dims, bool zero_vals, tg_tensor_t** ptr) {
+    return tensor_init_block(dims, n_dims, true, zero_vals, ptr);
+}
 
-tg_err_t tensor_shape_init(size_t dims[], size_t n_dims, tg_tensor_shape_t* shape) {
-    assert(dims != NULL);
-    assert(n_dims > 0);
-    if (!shape) {return ERR_MEMORY_ALLOCATION; }
-
-    shape->n_dimensions = n_dims;
-
-    shape->dimensions = calloc(shape->n_dimensions, sizeof(size_t));
-    memcpy((void*)shape->dimensions, (const void*) dims, sizeof(size_t)*n_dims);
-    assert(*dims == *shape->dimensions);
+// A contiguous tensor over storage->data[offset ...], holding a reference
+// to the storage.
+tg_err_t tensor_init_from_storage(tg_storage_t* storage, size_t offset, size_t dims[], size_t n_dims,
+                                  tg_tensor_t** ptr) {
+    assert(storage != NULL);
+    assert(offset + total_elements_for_dimensions(dims, n_dims) <= storage->n_elements);
 
-    shape->strides = calloc(shape->n_dimensions, sizeof(size_t));
-    for(size_t i = 0; i < shape->n_dimensions; i++) {
-        size_t stride_length = 1;
-        for (size_t j = i + 1; j < shape->n_dimensions; j++) {
-            stride_length *= dims[j];
-        }
-        shape->strides[i] = stride_length;
-    }
+    tg_err_t err = tensor_init_block(dims, n_dims, false, true, ptr);
+    if (err != SUCCESS) { return err; }
+    tensor_attach_storage(*ptr, storage, offset);
     return SUCCESS;
 }
 
-void tensor_free(tg_tensor_t* tensor) {
-    assert(tensor != NULL);
-    free(tensor->input_tensors);
-    free(tensor);
+// Storage over n_elements values at `data`, which are not copied and keep
+// whatever alignment the caller gave them. The caller holds the returned
+// reference. With `owns_data` the buffer must come from malloc (or
+// aligned_alloc) and is freed with the storage.
+tg_err_t tensor_storage_wrap(tg_value_t* data, size_t n_elements, bool owns_data, tg_storage_t** ptr) {
+    assert(data != NULL || n_elements == 0);
+    tg_alloc_kind_t kind = tensor_alloc_kind_current();
+    tg_storage_t* storage = tensor_alloc_block(kind, sizeof(tg_storage_t), true);
+    if (!storage) { return ERR_MEMORY_ALLOCATION; }
+    *storage = (tg_storage_t){
+        .data = data,
+        .n_elements = n_elements,
+        .ref_count = 1,
+        .owns_data = owns_data,
+        .alloc = kind,
+        .block = storage,
+    };
+    *ptr = storage;
+    return SUCCESS;
 }
 
-void tensor_free_recursive(tg_tensor_t* tensor) {
-    assert(tensor != NULL);
+void tensor_storage_retain(tg_storage_t* storage) {
+    assert(storage != NULL);
+    storage->ref_count += 1;
+}
 
-    if(tensor->ref_count > 1) {
-        tensor->ref_count -= 1;
-        return;
+void tensor_storage_release(tg_storage_t* storage) {
+    if (!storage) { return; }
+    assert(storage->ref_count > 0);
+    if (--storage->ref_count > 0) { return; }
+    if (storage->owns_data) {
+        free(storage->data);
     }
+    tensor_release(storage->alloc, storage->block);
+}
 
-    for(size_t i = 0; i < tensor->n_input_tensors; ++i) {
-        tensor_free_recursive(tensor->input_tensors[i]);
-    }
-    free(tensor->input_tensors);
-    free(tensor);
+size_t tensor_version(const tg_tensor_t* tensor) {
+    return tensor->storage->version;
 }
 
-tg_err_t tensor_backward_pass(tg_tensor_t* tensor) {
-    TENSOR_GRADS_SET(tensor, 1.0);
-    return tensor->backward(tensor);
+tg_err_t tensor_init(size_t dims[], size_t n_dims, tg_tensor_t** ptr) {
+    return tensor_init_with(dims, n_dims, true, ptr);
 }
 
+static tg_err_t tensor_init_uninit(size_t dims[], size_t n_dims, tg_tensor_t** ptr) {
+    return tensor_init_with(dims, n_dims, false, ptr);
+}
 
+// ==============================
+//    SIMD elementwise kernels
+// ==============================
+// Every kernel is stamped out once per instruction set from the lane
+// primitives TG_<ISA>_* defined below: a vector main loop followed by
+// a scalar tail. Both evaluate the same IEEE operations in the same order
+// (no FMA contraction; the polynomials use the unfused MULADD), so all
+// instruction sets give bit-identical results. The reductions (sum, dot,
+// logsumexp, gemm_tile) are the exception: their summation order and MADD
+// (fused where available) depend on the vector width.
+#define TG_SIMD_LOOP(W, vector_body, scalar_body) \
+    size_t i = 0; \
+    for (; i + (W) <= n; i += (W)) { vector_body; } \
+    for (; i < n; i++) { scalar_body; }
 
+#define TG_SIMD_DEFINE_KERNELS(NAME, ATTR) \
+    /* exp(x) = 2^n * exp(r) with n = round(x / ln2) and |r| <= ln2 / 2, */ \
+    /* exp(r) from a degree-6 polynomial (Cephes expf). Below -87.34 the */ \
+    /* result flushes to 0, above 88.72 it is +inf; NaN passes through. */ \
+    ATTR static inline TG_V tensor_simd_##NAME##_vexp(TG_V x) { \
+        TG_V xc = TG_MIN(TG_MAX(x, TG_SET1(-87.33654f)), TG_SET1(88.72283f)); \
+        TG_V k = TG_ROUND(TG_MUL(xc, TG_SET1(1.44269504f))); \
+        TG_V r = TG_SUB(TG_SUB(xc, TG_MUL(k, TG_SET1(0.693359375f))), TG_MUL(k, TG_SET1(-2.12194440e-4f))); \
+        TG_V p = TG_SET1(1.9875691500e-4f); \
+        p = TG_MULADD(p, r, TG_SET1(1.3981999507e-3f)); \
+        p = TG_MULADD(p, r, TG_SET1(8.3334519073e-3f)); \
+        p = TG_MULADD(p, r, TG_SET1(4.1665795894e-2f)); \
+        p = TG_MULADD(p, r, TG_SET1(1.6666665459e-1f)); \
+        p = TG_MULADD(p, r, TG_SET1(5.0000001201e-1f)); \
+        TG_V y = TG_ADD(TG_MULADD(TG_MUL(p, r), r, r), TG_SET1(1.0f)); \
+        /* Scale by 2^(k - s) * 2^s so that k = 128 fits the exponent field. */ \
+        TG_V s = TG_GT0_SEL(k, TG_SET1(1.0f)); \
+        y = TG_MUL(TG_MUL(y, TG_POW2(TG_SUB(k, s))), TG_ADD(s, TG_SET1(1.0f))); \
+        y = TG_ADD(y, TG_GT0_SEL(TG_SUB(x, TG_SET1(88.72283f)), TG_SET1(INFINITY))); \
+        return TG_NAN_PASS(x, TG_GT0_SEL(TG_SUB(x, TG_SET1(-87.33654f)), y)); \
+    } \
+    /* log(x) = e * ln2 + log(m) with x = 2^e * m, m in [sqrt(1/2), sqrt(2)), */ \
+    /* log(m) from a degree-8 polynomial in m - 1 (Cephes logf). Subnormal x */ \
+    /* is scaled by 2^23 first. As in libm, log(+-0) = -inf, log(+inf) = +inf */ \
+    /* and negative or NaN x give NaN. */ \
+    ATTR static inline TG_V tensor_simd_##NAME##_vlog(TG_V x) { \
+        TG_V tiny = TG_GT0_SEL(TG_SUB(TG_SET1(FLT_MIN), x), TG_SET1(1.0f)); \
+        TG_V xs = TG_MUL(x, TG_MULADD(tiny, TG_SET1(8388607.0f), TG_SET1(1.0f))); \
+        TG_V e = TG_SUB(TG_EXPONENT(xs), TG_MUL(tiny, TG_SET1(23.0f))); \
+        TG_V m = TG_MANTISSA(xs); \
+        TG_V big = TG_GT0_SEL(TG_SUB(m, TG_SET1(1.41421356f)), TG_SET1(1.0f)); \
+        m = TG_SUB(m, TG_MUL(big, TG_MUL(m, TG_SET1(0.5f)))); \
+        e = TG_ADD(e, big); \
+        TG_V f = TG_SUB(m, TG_SET1(1.0f)); \
+        TG_V z = TG_MUL(f, f); \
+        TG_V p = TG_SET1(7.0376836292e-2f); \
+        p = TG_MULADD(p, f, TG_SET1(-1.1514610310e-1f)); \
+        p = TG_MULADD(p, f, TG_SET1(1.1676998740e-1f)); \
+        p = TG_MULADD(p, f, TG_SET1(-1.2420140846e-1f)); \
+        p = TG_MULADD(p, f, TG_SET1(1.4249322787e-1f)); \
+        p = TG_MULADD(p, f, TG_SET1(-1.6668057665e-1f)); \
+        p = TG_MULADD(p, f, TG_SET1(2.0000714765e-1f)); \
+        p = TG_MULADD(p, f, TG_SET1(-2.4999993993e-1f)); \
+        p = TG_MULADD(p, f, TG_SET1(3.3333331174e-1f)); \
+        TG_V y = TG_MUL(TG_MUL(p, f), z); \
+        y = TG_MULADD(e, TG_SET1(-2.12194440e-4f), y); \
+        y = TG_SUB(y, TG_MUL(z, TG_SET1(0.5f))); \
+        y = TG_MULADD(e, TG_SET1(0.693359375f), TG_ADD(f, y)); \
+        TG_V nonpositive = TG_GT0_BLEND(TG_SUB(TG_SET1(0.0f), x), TG_SET1(NAN), TG_SET1(-INFINITY)); \
+        y = TG_GT0_BLEND(x, y, nonpositive); \
+        y = TG_GT0_BLEND(TG_SUB(x, TG_SET1(FLT_MAX)), TG_SET1(INFINITY), y); \
+        return TG_NAN_PASS(x, y); \
+    } \
+    /* tanh(|x|) = 1 - 2 / (exp(2|x|) + 1) from 0.625 up; below, an odd */ \
+    /* polynomial avoids the cancellation (Cephes tanhf). The sign is x's, */ \
+    /* so tanh(-0) = -0. */ \
+    ATTR static inline TG_V tensor_simd_##NAME##_vtanh(TG_V x) { \
+        TG_V a = TG_ABS(x); \
+        TG_V one = TG_SET1(1.0f); \
+        TG_V large = TG_SUB(one, TG_DIV(TG_SET1(2.0f), TG_ADD(tensor_simd_##NAME##_vexp(TG_ADD(a, a)), one))); \
+        TG_V s = TG_MIN(a, TG_SET1(0.625f)); \
+        TG_V z = TG_MUL(s, s); \
+        TG_V p = TG_SET1(-5.70498872745e-3f); \
+        p = TG_MULADD(p, z, TG_SET1(2.06390887954e-2f)); \
+        p = TG_MULADD(p, z, TG_SET1(-5.37397155531e-2f)); \
+        p = TG_MULADD(p, z, TG_SET1(1.33314422036e-1f)); \
+        p = TG_MULADD(p, z, TG_SET1(-3.33332819422e-1f)); \
+        TG_V small = TG_MULADD(TG_MUL(p, z), s, s); \
+        TG_V k = TG_GT0_SEL(TG_SUB(a, TG_SET1(0.625f)), one); \
+        TG_V t = TG_ADD(TG_MUL(k, large), TG_MUL(TG_SUB(one, k), small)); \
+        return TG_NAN_PASS(x, TG_COPYSIGN(t, x)); \
+    } \
+    ATTR static inline TG_V tensor_simd_##NAME##_vsigmoid(TG_V x) { \
+        TG_V one = TG_SET1(1.0f); \
+        return TG_DIV(one, TG_ADD(one, tensor_simd_##NAME##_vexp(TG_SUB(TG_SET1(0.0f), x)))); \
+    } \
+    ATTR static void tensor_simd_##NAME##_add(const tg_value_t* x, const tg_value_t* y, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, TG_ADD(TG_LD(x + i), TG_LD(y + i))), out[i] = x[i] + y[i]) \
+    } \
+    ATTR static void tensor_simd_##NAME##_sub(const tg_value_t* x, const tg_value_t* y, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, TG_SUB(TG_LD(x + i), TG_LD(y + i))), out[i] = x[i] - y[i]) \
+    } \
+    ATTR static void tensor_simd_##NAME##_mul(const tg_value_t* x, const tg_value_t* y, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, TG_MUL(TG_LD(x + i), TG_LD(y + i))), out[i] = x[i] * y[i]) \
+    } \
+    ATTR static void tensor_simd_##NAME##_div(const tg_value_t* x, const tg_value_t* y, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, TG_DIV(TG_LD(x + i), TG_LD(y + i))), out[i] = x[i] / y[i]) \
+    } \
+    ATTR static void tensor_simd_##NAME##_grad_acc(tg_value_t* dst, const tg_value_t* d, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(dst + i, TG_ADD(TG_LD(dst + i), TG_LD(d + i))), dst[i] += d[i]) \
+    } \
+    ATTR static void tensor_simd_##NAME##_grad_acc_neg(tg_value_t* dst, const tg_value_t* d, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(dst + i, TG_SUB(TG_LD(dst + i), TG_LD(d + i))), dst[i] -= d[i]) \
+    } \
+    ATTR static void tensor_simd_##NAME##_grad_mul(tg_value_t* dst, const tg_value_t* d, const tg_value_t* y, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(dst + i, TG_ADD(TG_LD(dst + i), TG_MUL(TG_LD(d + i), TG_LD(y + i)))), dst[i] += d[i] * y[i]) \
+    } \
+    ATTR static void tensor_simd_##NAME##_grad_div_lhs(tg_value_t* dst, const tg_value_t* d, const tg_value_t* y, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(dst + i, TG_ADD(TG_LD(dst + i), TG_MUL(TG_LD(d + i), TG_DIV(TG_SET1(1.0f), TG_LD(y + i))))), \
+                     dst[i] += d[i] * (1 / y[i])) \
+    } \
+    ATTR static void tensor_simd_##NAME##_grad_div_rhs(tg_value_t* dst, const tg_value_t* d, const tg_value_t* x, \
+                                                      const tg_value_t* y, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(dst + i, TG_ADD(TG_LD(dst + i), TG_MUL(TG_LD(d + i), \
+                          TG_DIV(TG_SUB(TG_SET1(0.0f), TG_LD(x + i)), TG_MUL(TG_LD(y + i), TG_LD(y + i)))))), \
+                     dst[i] += d[i] * (-x[i] / (y[i] * y[i]))) \
+    } \
+    ATTR static void tensor_simd_##NAME##_scalar_add(const tg_value_t* x, tg_value_t s, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, TG_ADD(TG_LD(x + i), TG_SET1(s))), out[i] = x[i] + s) \
+    } \
+    ATTR static void tensor_simd_##NAME##_scalar_sub(const tg_value_t* x, tg_value_t s, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, TG_SUB(TG_LD(x + i), TG_SET1(s))), out[i] = x[i] - s) \
+    } \
+    ATTR static void tensor_simd_##NAME##_scalar_mul(const tg_value_t* x, tg_value_t s, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, TG_MUL(TG_LD(x + i), TG_SET1(s))), out[i] = x[i] * s) \
+    } \
+    ATTR static void tensor_simd_##NAME##_sqrt(const tg_value_t* x, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, TG_SQRT(TG_LD(x + i))), out[i] = sqrtf(x[i])) \
+    } \
+    ATTR static void tensor_simd_##NAME##_abs(const tg_value_t* x, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, TG_ABS(TG_LD(x + i))), out[i] = fabsf(x[i])) \
+    } \
+    ATTR static void tensor_simd_##NAME##_relu(const tg_value_t* x, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, TG_NAN_PASS(TG_LD(x + i), TG_MAX(TG_LD(x + i), TG_SET1(0.0f)))), \
+                     out[i] = x[i] > 0 || isnan(x[i]) ? x[i] : 0.0f) \
+    } \
+    ATTR static void tensor_simd_##NAME##_exp(const tg_value_t* x, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, tensor_simd_##NAME##_vexp(TG_LD(x + i))), \
+                     out[i] = tensor_simd_SCALAR_vexp(x[i])) \
+    } \
+    ATTR static void tensor_simd_##NAME##_log(const tg_value_t* x, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, tensor_simd_##NAME##_vlog(TG_LD(x + i))), \
+                     out[i] = tensor_simd_SCALAR_vlog(x[i])) \
+    } \
+    ATTR static void tensor_simd_##NAME##_tanh(const tg_value_t* x, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, tensor_simd_##NAME##_vtanh(TG_LD(x + i))), \
+                     out[i] = tensor_simd_SCALAR_vtanh(x[i])) \
+    } \
+    ATTR static void tensor_simd_##NAME##_sigmoid(const tg_value_t* x, tg_value_t* out, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(out + i, tensor_simd_##NAME##_vsigmoid(TG_LD(x + i))), \
+                     out[i] = tensor_simd_SCALAR_vsigmoid(x[i])) \
+    } \
+    ATTR static void tensor_simd_##NAME##_grad_relu(tg_value_t* dst, const tg_value_t* d, const tg_value_t* x, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(dst + i, TG_ADD(TG_LD(dst + i), TG_GT0_SEL(TG_LD(x + i), TG_LD(d + i)))), \
+                     dst[i] += x[i] > 0 ? d[i] : 0.0f) \
+    } \
+    ATTR static void tensor_simd_##NAME##_grad_tanh(tg_value_t* dst, const tg_value_t* d, const tg_value_t* y, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(dst + i, TG_ADD(TG_LD(dst + i), \
+                          TG_MUL(TG_LD(d + i), TG_SUB(TG_SET1(1.0f), TG_MUL(TG_LD(y + i), TG_LD(y + i)))))), \
+                     dst[i] += d[i] * (1.0f - y[i] * y[i])) \
+    } \
+    ATTR static void tensor_simd_##NAME##_grad_sigmoid(tg_value_t* dst, const tg_value_t* d, const tg_value_t* y, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(dst + i, TG_ADD(TG_LD(dst + i), \
+                          TG_MUL(TG_MUL(TG_LD(d + i), TG_LD(y + i)), TG_SUB(TG_SET1(1.0f), TG_LD(y + i))))), \
+                     dst[i] += d[i] * y[i] * (1.0f - y[i])) \
+    } \
+    ATTR static tg_value_t tensor_simd_##NAME##_logsumexp(const tg_value_t* x, size_t n) { \
+        /* Running max m and sum of exp(x - m); the sum is rescaled when m grows. */ \
+        tg_value_t m = -INFINITY; \
+        TG_V acc = TG_SET1(0.0f); \
+        tg_value_t tail = 0.0f; \
+        tg_value_t lanes[TG_W]; \
+        for (size_t start = 0; start < n; start += TG_LSE_CHUNK) { \
+            const tg_value_t* c = x + start; \
+            size_t len = n - start < TG_LSE_CHUNK ? n - start : TG_LSE_CHUNK; \
+            TG_V vmax = TG_SET1(-INFINITY); \
+            size_t i = 0; \
+            for (; i + (TG_W) <= len; i += (TG_W)) { vmax = TG_MAX(vmax, TG_LD(c + i)); } \
+            TG_ST(lanes, vmax); \
+            tg_value_t cmax = m; \
+            for (size_t k = 0; k < (TG_W); k++) { cmax = lanes[k] > cmax ? lanes[k] : cmax; } \
+            for (; i < len; i++) { cmax = c[i] > cmax ? c[i] : cmax; } \
+            if (cmax > m) { \
+                tg_value_t r = tensor_simd_SCALAR_vexp(m - cmax); \
+                acc = TG_MUL(acc, TG_SET1(r)); \
+                tail *= r; \
+                m = cmax; \
+            } \
+            TG_V vm = TG_SET1(m); \
+            for (i = 0; i + (TG_W) <= len; i += (TG_W)) { \
+                acc = TG_ADD(acc, tensor_simd_##NAME##_vexp(TG_SUB(TG_LD(c + i), vm))); \
+            } \
+            for (; i < len; i++) { tail += tensor_simd_SCALAR_vexp(c[i] - m); } \
+        } \
+        TG_ST(lanes, acc); \
+        for (size_t width = (TG_W); width > 1; width /= 2) { \
+            for (size_t k = 0; k < width / 2; k++) { lanes[k] += lanes[k + width / 2]; } \
+        } \
+        return m + logf(lanes[0] + tail); \
+    } \
+    ATTR static void tensor_simd_##NAME##_grad_softmax(tg_value_t* dst, const tg_value_t* x, tg_value_t shift, \
+                                                       tg_value_t scale, size_t n) { \
+        TG_V vs = TG_SET1(shift); \
+        TG_V vc = TG_SET1(scale); \
+        TG_SIMD_LOOP(TG_W, \
+                     TG_ST(dst + i, TG_MULADD(vc, tensor_simd_##NAME##_vexp(TG_SUB(TG_LD(x + i), vs)), TG_LD(dst + i))), \
+                     dst[i] += scale * tensor_simd_SCALAR_vexp(x[i] - shift)) \
+    } \
+    ATTR static void tensor_simd_##NAME##_axpy(tg_value_t* y, tg_value_t alpha, const tg_value_t* x, size_t n) { \
+        TG_SIMD_LOOP(TG_W, TG_ST(y + i, TG_ADD(TG_LD(y + i), TG_MUL(TG_SET1(alpha), TG_LD(x + i)))), y[i] += alpha * x[i]) \
+    } \
+    ATTR static tg_value_t tensor_simd_##NAME##_sum(const tg_value_t* x, size_t n) { \
+        TG_V acc0 = TG_SET1(0.0f), acc1 = TG_SET1(0.0f), acc2 = TG_SET1(0.0f), acc3 = TG_SET1(0.0f); \
+        size_t i = 0; \
+        for (; i + 4 * (TG_W) <= n; i += 4 * (TG_W)) { \
+            acc0 = TG_ADD(acc0, TG_LD(x + i)); \
+            acc1 = TG_ADD(acc1, TG_LD(x + i + (TG_W))); \
+            acc2 = TG_ADD(acc2, TG_LD(x + i + 2 * (TG_W))); \
+            acc3 = TG_ADD(acc3, TG_LD(x + i + 3 * (TG_W))); \
+        } \
+        for (; i + (TG_W) <= n; i += (TG_W)) { \
+            acc0 = TG_ADD(acc0, TG_LD(x + i)); \
+        } \
+        tg_value_t lanes[TG_W]; \
+        TG_ST(lanes, TG_ADD(TG_ADD(acc0, acc1), TG_ADD(acc2, acc3))); \
+        for (size_t width = (TG_W); width > 1; width /= 2) { \
+            for (size_t k = 0; k < width / 2; k++) { lanes[k] += lanes[k + width / 2]; } \
+        } \
+        tg_value_t tail = 0.0f; \
+        for (; i < n; i++) { tail += x[i]; } \
+        return lanes[0] + tail; \
+    } \
+    ATTR static tg_value_t tensor_simd_##NAME##_dot(const tg_value_t* x, const tg_value_t* y, size_t n) { \
+        /* Four accumulators hide the add latency; lanes are reduced pairwise. */ \
+        TG_V acc0 = TG_SET1(0.0f), acc1 = TG_SET1(0.0f), acc2 = TG_SET1(0.0f), acc3 = TG_SET1(0.0f); \
+        size_t i = 0; \
+        for (; i + 4 * (TG_W) <= n; i += 4 * (TG_W)) { \
+            acc0 = TG_ADD(acc0, TG_MUL(TG_LD(x + i), TG_LD(y + i))); \
+            acc1 = TG_ADD(acc1, TG_MUL(TG_LD(x + i + (TG_W)), TG_LD(y + i + (TG_W)))); \
+            acc2 = TG_ADD(acc2, TG_MUL(TG_LD(x + i + 2 * (TG_W)), TG_LD(y + i + 2 * (TG_W)))); \
+            acc3 = TG_ADD(acc3, TG_MUL(TG_LD(x + i + 3 * (TG_W)), TG_LD(y + i + 3 * (TG_W)))); \
+        } \
+        for (; i + (TG_W) <= n; i += (TG_W)) { \
+            acc0 = TG_ADD(acc0, TG_MUL(TG_LD(x + i), TG_LD(y + i))); \
+        } \
+        tg_value_t lanes[TG_W]; \
+        TG_ST(lanes, TG_ADD(TG_ADD(acc0, acc1), TG_ADD(acc2, acc3))); \
+        for (size_t width = (TG_W); width > 1; width /= 2) { \
+            for (size_t k = 0; k < width / 2; k++) { lanes[k] += lanes[k + width / 2]; } \
+        } \
+        tg_value_t tail = 0.0f; \
+        for (; i < n; i++) { tail += x[i] * y[i]; } \
+        return lanes[0] + tail; \
+    } \
+    ATTR static void tensor_simd_##NAME##_gemm_tile(size_t kc, const tg_value_t* a, const tg_value_t* b, \
+                                                    tg_value_t* tile) { \
+        /* MR x NR/width vector accumulators, kept in registers across the k loop. */ \
+        TG_V acc[TG_GEMM_MR][TG_GEMM_NR / (TG_W)]; \
+        for (size_t r = 0; r < TG_GEMM_MR; r++) { \
+            for (size_t c = 0; c < TG_GEMM_NR / (TG_W); c++) { acc[r][c] = TG_SET1(0.0f); } \
+        } \
+        for (size_t p = 0; p < kc; p++) { \
+            TG_V bv[TG_GEMM_NR / (TG_W)]; \
+            for (size_t c = 0; c < TG_GEMM_NR / (TG_W); c++) { bv[c] = TG_LD(b + p * TG_GEMM_NR + c * (TG_W)); } \
+            for (size_t r = 0; r < TG_GEMM_MR; r++) { \
+                TG_V av = TG_SET1(a[p * TG_GEMM_MR + r]); \
+                for (size_t c = 0; c < TG_GEMM_NR / (TG_W); c++) { acc[r][c] = TG_MADD(av, bv[c], acc[r][c]); } \
+            } \
+        } \
+        for (size_t r = 0; r < TG_GEMM_MR; r++) { \
+            for (size_t c = 0; c < TG_GEMM_NR / (TG_W); c++) { TG_ST(tile + r * TG_GEMM_NR + c * (TG_W), acc[r][c]); } \
+        } \
+    } \
+    static const tg_simd_kernels_t tg_simd_##NAME##_kernels = { \
+        .isa = TG_ISA_##NAME, \
+        .add = tensor_simd_##NAME##_add, \
+        .sub = tensor_simd_##NAME##_sub, \
+        .mul = tensor_simd_##NAME##_mul, \
+        .div = tensor_simd_##NAME##_div, \
+        .grad_acc = tensor_simd_##NAME##_grad_acc, \
+        .grad_acc_neg = tensor_simd_##NAME##_grad_acc_neg, \
+        .grad_mul = tensor_simd_##NAME##_grad_mul, \
+        .grad_div_lhs = tensor_simd_##NAME##_grad_div_lhs, \
+        .grad_div_rhs = tensor_simd_##NAME##_grad_div_rhs, \
+        .scalar_add = tensor_simd_##NAME##_scalar_add, \
+        .scalar_sub = tensor_simd_##NAME##_scalar_sub, \
+        .scalar_mul = tensor_simd_##NAME##_scalar_mul, \
+        .sqrt = tensor_simd_##NAME##_sqrt, \
+        .abs = tensor_simd_##NAME##_abs, \
+        .relu = tensor_simd_##NAME##_relu, \
+        .exp = tensor_simd_##NAME##_exp, \
+        .log = tensor_simd_##NAME##_log, \
+        .tanh = tensor_simd_##NAME##_tanh, \
+        .sigmoid = tensor_simd_##NAME##_sigmoid, \
+        .grad_relu = tensor_simd_##NAME##_grad_relu, \
+        .grad_tanh = tensor_simd_##NAME##_grad_tanh, \
+        .grad_sigmoid = tensor_simd_##NAME##_grad_sigmoid, \
+        .logsumexp = tensor_simd_##NAME##_logsumexp, \
+        .grad_softmax = tensor_simd_##NAME##_grad_softmax, \
+        .axpy = tensor_simd_##NAME##_axpy, \
+        .sum = tensor_simd_##NAME##_sum, \
+        .dot = tensor_simd_##NAME##_dot, \
+        .gemm_tile = tensor_simd_##NAME##_gemm_tile, \
+    };
 
-tg_err_t tensor_scalar_add(tg_tensor_t* tensor, tg_value_t scalar) {
-      TENSOR_SCALAR_OP(tensor, scalar, +);
-      return SUCCESS;
-}
-tg_err_t tensor_scalar_sub(tg_tensor_t* tensor, tg_value_t scalar) {
-      TENSOR_SCALAR_OP(tensor, scalar, -);
-      return SUCCESS;
-}
-tg_err_t tensor_scalar_mul(tg_tensor_t* tensor, tg_value_t scalar) {
-      TENSOR_SCALAR_OP(tensor, scalar, *);
-      return SUCCESS;
-}
-tg_err_t tensor_scalar_div(tg_tensor_t* tensor, tg_value_t scalar) {
-      TENSOR_SCALAR_OP(tensor, scalar, /);
-      return SUCCESS;
-}
+// Lane primitives: TG_<ISA>_V is the vector type and TG_<ISA>_W its width.
+// The template refers to them as TG_V, TG_LD, ... which resolve against
+// TG_SIMD_ISA, defined around each instantiation.
+#define TG_SIMD_PRIM_(isa, op) TG_##isa##_##op
+#define TG_SIMD_PRIM(isa, op) TG_SIMD_PRIM_(isa, op)
+#define TG_V TG_SIMD_PRIM(TG_SIMD_ISA, V)
+#define TG_W TG_SIMD_PRIM(TG_SIMD_ISA, W)
+#define TG_LD TG_SIMD_PRIM(TG_SIMD_ISA, LD)
+#define TG_ST TG_SIMD_PRIM(TG_SIMD_ISA, ST)
+#define TG_ADD TG_SIMD_PRIM(TG_SIMD_ISA, ADD)
+#define TG_SUB TG_SIMD_PRIM(TG_SIMD_ISA, SUB)
+#define TG_MUL TG_SIMD_PRIM(TG_SIMD_ISA, MUL)
+#define TG_DIV TG_SIMD_PRIM(TG_SIMD_ISA, DIV)
+#define TG_SET1 TG_SIMD_PRIM(TG_SIMD_ISA, SET1)
+#define TG_SQRT TG_SIMD_PRIM(TG_SIMD_ISA, SQRT)
+#define TG_ABS TG_SIMD_PRIM(TG_SIMD_ISA, ABS)
+#define TG_MADD TG_SIMD_PRIM(TG_SIMD_ISA, MADD)
+// a * b + c rounded after each step on every ISA, unlike MADD.
+#define TG_MULADD(a, b, c) TG_ADD(TG_MUL((a), (b)), (c))
+#define TG_MAX TG_SIMD_PRIM(TG_SIMD_ISA, MAX)
+#define TG_MIN TG_SIMD_PRIM(TG_SIMD_ISA, MIN)
+#define TG_ROUND TG_SIMD_PRIM(TG_SIMD_ISA, ROUND)
+#define TG_POW2 TG_SIMD_PRIM(TG_SIMD_ISA, POW2)
+#define TG_EXPONENT TG_SIMD_PRIM(TG_SIMD_ISA, EXPONENT)
+#define TG_MANTISSA TG_SIMD_PRIM(TG_SIMD_ISA, MANTISSA)
+#define TG_GT0_SEL TG_SIMD_PRIM(TG_SIMD_ISA, GT0_SEL)
+#define TG_GT0_BLEND TG_SIMD_PRIM(TG_SIMD_ISA, GT0_BLEND)
+#define TG_NAN_PASS TG_SIMD_PRIM(TG_SIMD_ISA, NAN_PASS)
+#define TG_COPYSIGN TG_SIMD_PRIM(TG_SIMD_ISA, COPYSIGN)
 
-tg_err_t tensor_sqrt(tg_tensor_t* tensor) {
-    for (size_t i = 0; i < (tensor)->n_elements; i++) { 
-          (tensor)->vals[i] = sqrtf((tensor)->vals[i]); 
-    }
-    return SUCCESS;
+// Bit-level helpers behind the scalar EXPONENT and MANTISSA, matching the
+// vector versions: x = 2^EXPONENT(x) * MANTISSA(x) with MANTISSA in [1, 2).
+static inline tg_value_t tensor_scalar_exponent(tg_value_t x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return (tg_value_t)((int32_t)((bits >> 23) & 0xff) - 127);
 }
 
-tg_err_t tensor_abs(tg_tensor_t* tensor) {
-    for (size_t i = 0; i < (tensor)->n_elements; i++) { 
-          (tensor)->vals[i] = fabsf((tensor)->vals[i]); 
-    }
-    return SUCCESS;
+static inline tg_value_t tensor_scalar_mantissa(tg_value_t x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    bits = (bits & 0x007fffff) | 0x3f800000;
+    memcpy(&x, &bits, sizeof(bits));
+    return x;
 }
 
-tg_err_t tensor_create_graph(tg_tensor_t* tensor, \
-                              tg_tensor_t* a, \
-                              tg_tensor_t* b, \
-                              enum tg_backward_op op) {
-    assert(tensor != NULL);
-    assert(a != NULL);
-    assert(b != NULL);
+#define TG_SCALAR_V tg_value_t
+#define TG_SCALAR_W 1
+#define TG_SCALAR_LD(p) (*(p))
+#define TG_SCALAR_ST(p, v) (*(p) = (v))
+#define TG_SCALAR_ADD(a, b) ((a) + (b))
+#define TG_SCALAR_SUB(a, b) ((a) - (b))
+#define TG_SCALAR_MUL(a, b) ((a) * (b))
+#define TG_SCALAR_DIV(a, b) ((a) / (b))
+#define TG_SCALAR_SET1(v) (v)
+#define TG_SCALAR_SQRT(v) sqrtf(v)
+#define TG_SCALAR_ABS(v) fabsf(v)
+#define TG_SCALAR_MADD(a, b, c) ((a) * (b) + (c))
+#define TG_SCALAR_MAX(a, b) fmaxf((a), (b))
+#define TG_SCALAR_MIN(a, b) fminf((a), (b))
+#define TG_SCALAR_ROUND(v) rintf(v)
+#define TG_SCALAR_POW2(k) ldexpf(1.0f, (int)(k))
+#define TG_SCALAR_EXPONENT(v) tensor_scalar_exponent(v)
+#define TG_SCALAR_MANTISSA(v) tensor_scalar_mantissa(v)
+// v where x > 0, else 0.
+#define TG_SCALAR_GT0_SEL(x, v) ((x) > 0 ? (v) : 0.0f)
+// v where x > 0, else y.
+#define TG_SCALAR_GT0_BLEND(x, v, y) ((x) > 0 ? (v) : (y))
+// x where x is NaN, else y.
+#define TG_SCALAR_NAN_PASS(x, y) (isnan(x) ? (x) : (y))
+// |m| with the sign of s.
+#define TG_SCALAR_COPYSIGN(m, s) copysignf((m), (s))
+#define TG_SIMD_NO_TARGET
 
-    // During backward pass:
-    //   - Calling backward(C) computes dL/dA and dL/dB
-    //   - Then recursively calls backward(A) and backward(B)
-    //
-    // This allows the loss gradient to flow backward through the entire graph:
-    //   Loss -> ... -> C -> A, B -> ... -> parameters
-    //
-    tensor->n_input_tensors = 2;
-    tensor->input_tensors = calloc(tensor->n_input_tensors, \
-                                   sizeof(tg_tensor_t*));
-    tensor->input_tensors[0] = a;
-    tensor->input_tensors[1] = b;
+#define TG_SIMD_ISA SCALAR
+TG_SIMD_DEFINE_KERNELS(SCALAR, TG_SIMD_NO_TARGET)
+#undef TG_SIMD_ISA
 
-    a->ref_count += 1;
-    b->ref_count += 1;
+#ifdef TG_SIMD_X86
+#define TG_SSE2_V __m128
+#define TG_SSE2_W 4
+#define TG_SSE2_LD _mm_loadu_ps
+#define TG_SSE2_ST _mm_storeu_ps
+#define TG_SSE2_ADD _mm_add_ps
+#define TG_SSE2_SUB _mm_sub_ps
+#define TG_SSE2_MUL _mm_mul_ps
+#define TG_SSE2_DIV _mm_div_ps
+#define TG_SSE2_SET1 _mm_set1_ps
+#define TG_SSE2_SQRT _mm_sqrt_ps
+// |v| clears the sign bit.
+#define TG_SSE2_ABS(v) _mm_andnot_ps(_mm_set1_ps(-0.0f), (v))
+#define TG_SSE2_MADD(a, b, c) _mm_add_ps(_mm_mul_ps((a), (b)), (c))
+#define TG_SSE2_MAX _mm_max_ps
+#define TG_SSE2_MIN _mm_min_ps
+#define TG_SSE2_ROUND(v) _mm_cvtepi32_ps(_mm_cvtps_epi32(v))
+// 2^k for integral k by building the exponent field directly.
+#define TG_SSE2_POW2(k) \
+    _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(k), _mm_set1_epi32(127)), 23))
+#define TG_SSE2_EXPONENT(v) \
+    _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(v), 23), _mm_set1_epi32(127)))
+#define TG_SSE2_MANTISSA(v) \
+    _mm_or_ps(_mm_and_ps((v), _mm_castsi128_ps(_mm_set1_epi32(0x007fffff))), _mm_set1_ps(1.0f))
+#define TG_SSE2_GT0_SEL(x, v) _mm_and_ps(_mm_cmpgt_ps((x), _mm_setzero_ps()), (v))
+#define TG_SSE2_GT0_BLEND(x, v, y) \
+    _mm_or_ps(_mm_and_ps(_mm_cmpgt_ps((x), _mm_setzero_ps()), (v)), \
+              _mm_andnot_ps(_mm_cmpgt_ps((x), _mm_setzero_ps()), (y)))
+#define TG_SSE2_NAN_PASS(x, y) \
+    _mm_or_ps(_mm_and_ps(_mm_cmpunord_ps((x), (x)), (x)), _mm_andnot_ps(_mm_cmpunord_ps((x), (x)), (y)))
+#define TG_SSE2_COPYSIGN(m, s) \
+    _mm_or_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), (m)), _mm_and_ps(_mm_set1_ps(-0.0f), (s)))
 
-    switch (op) {
-        case TG_BOP_EL_ADD:
-            // Addition:
-            // d(A+B)/dA = 1,  d(A+B)/dB = 1
-            tensor->backward = tensor_backward_el_add;
-            break;
-        case TG_BOP_EL_SUB:
-            // Subtraction:
-            // d(A-B)/dA = 1,  d(A-B)/dB = -1
-            tensor->backward = tensor_backward_el_sub;
+#define TG_AVX2_V __m256
+#define TG_AVX2_W 8
+#define TG_AVX2_LD _mm256_loadu_ps
+#define TG_AVX2_ST _mm256_storeu_ps
+#define TG_AVX2_ADD _mm256_add_ps
+#define TG_AVX2_SUB _mm256_sub_ps
+#define TG_AVX2_MUL _mm256_mul_ps
+#define TG_AVX2_DIV _mm256_div_ps
+#define TG_AVX2_SET1 _mm256_set1_ps
+#define TG_AVX2_SQRT _mm256_sqrt_ps
+#define TG_AVX2_ABS(v) _mm256_andnot_ps(_mm256_set1_ps(-0.0f), (v))
+#define TG_AVX2_MADD _mm256_fmadd_ps
+#define TG_AVX2_MAX _mm256_max_ps
+#define TG_AVX2_MIN _mm256_min_ps
+#define TG_AVX2_ROUND(v) _mm256_round_ps((v), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+#define TG_AVX2_POW2(k) \
+    _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23))
+#define TG_AVX2_EXPONENT(v) \
+    _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(v), 23), _mm256_set1_epi32(127)))
+#define TG_AVX2_MANTISSA(v) \
+    _mm256_or_ps(_mm256_and_ps((v), _mm256_castsi256_ps(_mm256_set1_epi32(0x007fffff))), _mm256_set1_ps(1.0f))
+#define TG_AVX2_GT0_SEL(x, v) _mm256_and_ps(_mm256_cmp_ps((x), _mm256_setzero_ps(), _CMP_GT_OQ), (v))
+#define TG_AVX2_GT0_BLEND(x, v, y) _mm256_blendv_ps((y), (v), _mm256_cmp_ps((x), _mm256_setzero_ps(), _CMP_GT_OQ))
+#define TG_AVX2_NAN_PASS(x, y) _mm256_blendv_ps((y), (x), _mm256_cmp_ps((x), (x), _CMP_UNORD_Q))
+#define TG_AVX2_COPYSIGN(m, s) \
+    _mm256_or_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), (m)), _mm256_and_ps(_mm256_set1_ps(-0.0f), (s)))
+
+#define TG_AVX512_V __m512
+#define TG_AVX512_W 16
+#define TG_AVX512_LD _mm512_loadu_ps
+#define TG_AVX512_ST _mm512_storeu_ps
+#define TG_AVX512_ADD _mm512_add_ps
+#define TG_AVX512_SUB _mm512_sub_ps
+#define TG_AVX512_MUL _mm512_mul_ps
+#define TG_AVX512_DIV _mm512_div_ps
+#define TG_AVX512_SET1 _mm512_set1_ps
+#define TG_AVX512_SQRT _mm512_sqrt_ps
+#define TG_AVX512_ABS _mm512_abs_ps
+#define TG_AVX512_MADD _mm512_fmadd_ps
+#define TG_AVX512_MAX _mm512_max_ps
+#define TG_AVX512_MIN _mm512_min_ps
+#define TG_AVX512_ROUND(v) _mm512_roundscale_ps((v), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+#define TG_AVX512_POW2(k) \
+    _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(k), _mm512_set1_epi32(127)), 23))
+#define TG_AVX512_EXPONENT(v) \
+    _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(_mm512_castps_si512(v), 23), _mm512_set1_epi32(127)))
+#define TG_AVX512_MANTISSA(v) \
+    _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(_mm512_castps_si512(v), _mm512_set1_epi32(0x007fffff)), \
+                                        _mm512_set1_epi32(0x3f800000)))
+#define TG_AVX512_GT0_SEL(x, v) \
+    _mm512_maskz_mov_ps(_mm512_cmp_ps_mask((x), _mm512_setzero_ps(), _CMP_GT_OQ), (v))
+#define TG_AVX512_GT0_BLEND(x, v, y) \
+    _mm512_mask_mov_ps((y), _mm512_cmp_ps_mask((x), _mm512_setzero_ps(), _CMP_GT_OQ), (v))
+#define TG_AVX512_NAN_PASS(x, y) _mm512_mask_mov_ps((y), _mm512_cmp_ps_mask((x), (x), _CMP_UNORD_Q), (x))
+#define TG_AVX512_COPYSIGN(m, s) \
+    _mm512_castsi512_ps(_mm512_or_si512(_mm512_andnot_si512(_mm512_set1_epi32(INT32_MIN), _mm512_castps_si512(m)), \
+                                        _mm512_and_si512(_mm512_set1_epi32(INT32_MIN), _mm512_castps_si512(s))))
+
+#define TG_SIMD_ISA SSE2
+TG_SIMD_DEFINE_KERNELS(SSE2, __attribute__((target("sse2"))))
+#undef TG_SIMD_ISA
+#define TG_SIMD_ISA AVX2
+TG_SIMD_DEFINE_KERNELS(AVX2, __attribute__((target("avx2,fma"))))
+#undef TG_SIMD_ISA
+#define TG_SIMD_ISA AVX512
+TG_SIMD_DEFINE_KERNELS(AVX512, __attribute__((target("avx512f"))))
+#undef TG_SIMD_ISA
+#endif
+
+static const tg_simd_kernels_t* tg_simd = &tg_simd_SCALAR_kernels;
+
+bool tensor_simd_supported(tg_isa_t isa) {
+    switch (isa) {
+        case TG_ISA_SCALAR:
+            return true;
+#ifdef TG_SIMD_X86
+        case TG_ISA_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case TG_ISA_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case TG_ISA_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+// Switches every elementwise op to the kernels for `isa`. The best supported
+// set is selected at startup; this is mostly useful to benchmark or test the
+// narrower ones.
+tg_err_t tensor_simd_select(tg_isa_t isa) {
+    if (!tensor_simd_supported(isa)) {
+        return ERR_UNSUPPORTED_ISA;
+    }
+    switch (isa) {
+#ifdef TG_SIMD_X86
+        case TG_ISA_SSE2:
+            tg_simd = &tg_simd_SSE2_kernels;
             break;
-        case TG_BOP_EL_MUL:
-            // Multiplication:
-            // d(A*B)/dA = B,  d(A*B)/dB = A
-            tensor->backward = tensor_backward_el_mul;
+        case TG_ISA_AVX2:
+            tg_simd = &tg_simd_AVX2_kernels;
             break;
-        case TG_BOP_EL_DIV:
-            // Division:
-            // d(A/B)/dA = 1/B, d(A/B)/dB = -A/B²
-            tensor->backward = tensor_backward_el_div;
+        case TG_ISA_AVX512:
+            tg_simd = &tg_simd_AVX512_kernels;
             break;
-        case TG_BOP_MAT_MUL:
-        case TG_BOP_MEAN_REDUCTION:
-        case TG_BOP_SUM_REDUCTION:
-            TODO();
+#endif
         default:
-            TENSOR_DESTROY(tensor);
-            UNREACHABLE();
+            tg_simd = &tg_simd_SCALAR_kernels;
+            break;
     }
-
     return SUCCESS;
 }
 
-tg_err_t  tensor_backward_el_add(tg_tensor_t* tensor) {
-    if(tensor->n_input_tensors == 0) {
-        return SUCCESS;
-    }
+tg_isa_t tensor_simd_isa(void) {
+    return tg_simd->isa;
+}
 
-    assert(tensor->n_input_tensors == 2);
-    assert(tensor->input_tensors[0] != NULL);
-    assert(tensor->input_tensors[1] != NULL);
-    assert(tensor->input_tensors[0]->shape.n_dimensions\
-           == tensor->input_tensors[1]->shape.n_dimensions);
+#ifdef TG_SIMD_X86
+__attribute__((constructor)) static void tensor_simd_init(void) {
+    __builtin_cpu_init();
+    for (tg_isa_t isa = TG_ISA_AVX512; isa > TG_ISA_SCALAR; isa--) {
+        if (tensor_simd_select(isa) == SUCCESS) { return; }
+    }
+}
+#endif
 
-    tg_tensor_t* A = tensor->input_tensors[0];
-    tg_tensor_t* B = tensor->input_tensors[1];
+// ==============================
+//          Thread pool
+// ==============================
+// A single process-wide pool runs tensor_parallel_for jobs. Workers are
+// started on the first parallel job; the calling thread takes part as
+// worker 0, and parallel jobs issued from inside a job run serially.
+// tensor_thread_pool_shutdown joins the workers; the next job restarts them.
+static size_t tensor_default_num_threads(void) {
+    const char* env = getenv("TG_NUM_THREADS");
+    if (env && atoi(env) > 0) {
+        return (size_t)atoi(env);
+    }
+#ifndef TG_NO_THREADS
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+#else
+    return 1;
+#endif
+}
 
-    for (size_t i = 0; i < tensor->n_elements; i++) {
-         A->grads[i] += tensor->grads[i];
-         B->grads[i] += tensor->grads[i];
+size_t tensor_get_num_threads(void) {
+    size_t n_threads = atomic_load(&tg_num_threads);
+    if (n_threads == 0) {
+        // A concurrent tensor_set_num_threads wins over the default.
+        size_t expected = 0;
+        n_threads = tensor_default_num_threads();
+        if (!atomic_compare_exchange_strong(&tg_num_threads, &expected, n_threads)) {
+            n_threads = expected;
+        }
     }
-    
-    if(A->backward) A->backward(A);
-    if(B->backward) B->backward(B);
+    return n_threads;
+}
 
+#ifndef TG_NO_THREADS
+static void* tensor_thread_pool_worker(void* arg) {
+    size_t worker = (size_t)(uintptr_t)arg;
+    tg_thread_pool_t* pool = &tg_thread_pool;
+    tg_in_parallel = true;
 
-    return SUCCESS;
+    size_t seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->generation == seen && !pool->shutdown) {
+            pthread_cond_wait(&pool->work_ready, &pool->mutex);
+        }
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        seen = pool->generation;
+        bool takes_part = worker < pool->n_threads;
+        pthread_mutex_unlock(&pool->mutex);
+
+        size_t task;
+        while (takes_part && (task = atomic_fetch_add(&pool->next_task, 1)) < pool->n_tasks) {
+            pool->fn(pool->ctx, task, worker);
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->n_active == 0) {
+            pthread_cond_signal(&pool->work_done);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
 }
 
-tg_err_t tensor_backward_el_sub(tg_tensor_t* tensor) {
-    if(tensor->n_input_tensors == 0) {
-        return SUCCESS;
+static void tensor_thread_pool_stop(void) {
+    tg_thread_pool_t* pool = &tg_thread_pool;
+    if (pool->n_workers == 0) {
+        return;
     }
-    assert(tensor->n_input_tensors == 2);
-    assert(tensor->input_tensors[0] != NULL);
-    assert(tensor->input_tensors[1] != NULL);
-    assert(tensor->input_tensors[0]->shape.n_dimensions\
-           == tensor->input_tensors[1]->shape.n_dimensions);
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->mutex);
 
-    tg_tensor_t* A = tensor->input_tensors[0];
-    tg_tensor_t* B = tensor->input_tensors[1];
+    for (size_t i = 0; i < pool->n_workers; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->n_workers = 0;
+    pool->shutdown = false;
+}
 
-    for (size_t i = 0; i < tensor->n_elements; i++) {
-         A->grads[i] += tensor->grads[i];
-         B->grads[i] -= tensor->grads[i];
+// Starts n_threads - 1 workers; on failure the pool keeps whatever started.
+static void tensor_thread_pool_start(size_t n_threads) {
+    tg_thread_pool_t* pool = &tg_thread_pool;
+    pool->threads = malloc((n_threads - 1) * sizeof(pthread_t));
+    if (!pool->threads) {
+        return;
+    }
+    for (size_t i = 0; i + 1 < n_threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, tensor_thread_pool_worker,
+                           (void*)(uintptr_t)(i + 1)) != 0) {
+            break;
+        }
+        pool->n_workers += 1;
     }
-    
-    if(A->backward) A->backward(A);
-    if(B->backward) B->backward(B);
+}
+#endif
 
-    return SUCCESS;
+// Sets how many threads (including the caller) parallel kernels use; 0
+// restores the default, TG_NUM_THREADS or the number of online CPUs.
+void tensor_set_num_threads(size_t n_threads) {
+#ifndef TG_NO_THREADS
+    pthread_mutex_lock(&tg_thread_pool.submit);
+    tensor_thread_pool_stop();
+    atomic_store(&tg_num_threads, n_threads);
+    pthread_mutex_unlock(&tg_thread_pool.submit);
+#else
+    atomic_store(&tg_num_threads, n_threads);
+#endif
+}
+
+// Joins the pool's workers, e.g. before unloading the library or checking
+// for leaks. Later parallel jobs start them again.
+void tensor_thread_pool_shutdown(void) {
+#ifndef TG_NO_THREADS
+    pthread_mutex_lock(&tg_thread_pool.submit);
+    tensor_thread_pool_stop();
+    pthread_mutex_unlock(&tg_thread_pool.submit);
+#endif
+}
+
+// Runs fn(ctx, task, worker) for every task in [0, n_tasks) on at most
+// n_threads threads. `worker` is in [0, n_threads) and is never shared by
+// two concurrent calls, so it can index per-thread scratch sized from the
+// same n_threads; callers read tensor_get_num_threads() once and pass it
+// here, since the setting may change concurrently.
+static void tensor_parallel_for(size_t n_tasks, size_t n_threads,
+                                void (*fn)(void* ctx, size_t task, size_t worker), void* ctx) {
+#ifndef TG_NO_THREADS
+    if (n_tasks > 1 && !tg_in_parallel && n_threads > 1) {
+        tg_thread_pool_t* pool = &tg_thread_pool;
+        pthread_mutex_lock(&pool->submit);
+        if (pool->n_workers == 0) {
+            tensor_thread_pool_start(n_threads);
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->fn = fn;
+        pool->ctx = ctx;
+        pool->n_tasks = n_tasks;
+        pool->n_threads = n_threads;
+        atomic_store(&pool->next_task, 0);
+        pool->n_active = pool->n_workers;
+        pool->generation += 1;
+        pthread_cond_broadcast(&pool->work_ready);
+        pthread_mutex_unlock(&pool->mutex);
+
+        tg_in_parallel = true;
+        size_t task;
+        while ((task = atomic_fetch_add(&pool->next_task, 1)) < n_tasks) {
+            fn(ctx, task, 0);
+        }
+        tg_in_parallel = false;
+
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->n_active > 0) {
+            pthread_cond_wait(&pool->work_done, &pool->mutex);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+        pthread_mutex_unlock(&pool->submit);
+        return;
+    }
+#else
+    (void)n_threads;
+#endif
+    for (size_t task = 0; task < n_tasks; task++) {
+        fn(ctx, task, 0);
+    }
+}
+
+// ==============================
+//             GEMM
+// ==============================
+static inline tg_value_t tensor_gemm_at(const tg_value_t* x, size_t ld, bool trans, size_t row, size_t col) {
+    return trans ? x[col * ld + row] : x[row * ld + col];
+}
+
+// Packs rows [i0, i0 + mc) x cols [k0, k0 + kc) of op(A) into MR-row
+// slivers, column by column, zero-padding the last sliver.
+static void tensor_gemm_pack_a(const tg_value_t* a, size_t lda, bool trans_a,
+                               size_t i0, size_t k0, size_t mc, size_t kc, tg_value_t* out) {
+    for (size_t ir = 0; ir < mc; ir += TG_GEMM_MR) {
+        for (size_t p = 0; p < kc; p++) {
+            for (size_t r = 0; r < TG_GEMM_MR; r++) {
+                *out++ = ir + r < mc ? tensor_gemm_at(a, lda, trans_a, i0 + ir + r, k0 + p) : 0.0f;
+            }
+        }
+    }
+}
+
+// Packs rows [k0, k0 + kc) x cols [j0, j0 + nc) of op(B) into NR-column
+// slivers, row by row, zero-padding the last sliver.
+static void tensor_gemm_pack_b(const tg_value_t* b, size_t ldb, bool trans_b,
+                               size_t k0, size_t j0, size_t kc, size_t nc, tg_value_t* out) {
+    for (size_t jr = 0; jr < nc; jr += TG_GEMM_NR) {
+        for (size_t p = 0; p < kc; p++) {
+            for (size_t c = 0; c < TG_GEMM_NR; c++) {
+                *out++ = jr + c < nc ? tensor_gemm_at(b, ldb, trans_b, k0 + p, j0 + jr + c) : 0.0f;
+            }
+        }
+    }
+}
+
+static void tensor_graph_scratch_free(void* scratch) {
+    tg_graph_scratch_t* graph_scratch = scratch;
+    free(graph_scratch->frames);
+    free(graph_scratch->order);
+    *graph_scratch = (tg_graph_scratch_t){0};
+}
+
+#ifndef TG_NO_THREADS
+// Per-thread scratch buffers are registered under a pthread key once they are
+// allocated, so the key's destructor frees them when the thread exits.
+static pthread_key_t tg_gemm_scratch_key;
+static pthread_key_t tg_graph_scratch_key;
+static pthread_once_t tg_scratch_keys_once = PTHREAD_ONCE_INIT;
+
+static void tensor_scratch_keys_init(void) {
+    pthread_key_create(&tg_gemm_scratch_key, free);
+    pthread_key_create(&tg_graph_scratch_key, tensor_graph_scratch_free);
+}
+
+static void tensor_scratch_register(pthread_key_t* key, void* scratch) {
+    pthread_once(&tg_scratch_keys_once, tensor_scratch_keys_init);
+    pthread_setspecific(*key, scratch);
+}
+#endif
+
+// Packing buffers are kept per thread and reused across calls, so a stream of
+// small GEMMs does not pay an allocation each.
+static tg_value_t* tensor_gemm_scratch(size_t size) {
+    if (size > tg_gemm_scratch_size) {
+        free(tg_gemm_scratch);
+        tg_gemm_scratch = tensor_aligned_alloc(size);
+        tg_gemm_scratch_size = tg_gemm_scratch ? size : 0;
+#ifndef TG_NO_THREADS
+        tensor_scratch_register(&tg_gemm_scratch_key, tg_gemm_scratch);
+#endif
+    }
+    return tg_gemm_scratch;
+}
+
+// Pairwise sum of the block dot products; the split point stays on a block
+// boundary so every leaf is a full TG_DOT_BLOCK except the last.
+static double tensor_dot_pairwise(const tg_value_t* x, const tg_value_t* y, size_t n) {
+    if (n <= TG_DOT_BLOCK) {
+        return tg_simd->dot(x, y, n);
+    }
+    size_t half = (n / TG_DOT_BLOCK + 1) / 2 * TG_DOT_BLOCK;
+    return tensor_dot_pairwise(x, y, half) + tensor_dot_pairwise(x + half, y + half, n - half);
+}
+
+// Pairwise sum of block sums, split like tensor_dot_pairwise.
+static double tensor_sum_pairwise(const tg_value_t* x, size_t n) {
+    if (n <= TG_DOT_BLOCK) {
+        return tg_simd->sum(x, n);
+    }
+    size_t half = (n / TG_DOT_BLOCK + 1) / 2 * TG_DOT_BLOCK;
+    return tensor_sum_pairwise(x, half) + tensor_sum_pairwise(x + half, n - half);
+}
+
+// Products with a unit dimension are memory bound: there is no reuse for
+// packing to exploit, so tensor_gemm hands them to these kernels, which
+// stream the matrix exactly once.
+
+// y[l] += sum_k mat(l, k) * x[k], with mat(l, k) = mat[l * rs + k * cs] and
+// either rs or cs equal to 1. Row-contiguous matrices take one dot product
+// per output; column-contiguous ones accumulate columns with axpy.
+typedef struct {
+    const tg_value_t* mat;
+    size_t rs, cs;
+    const tg_value_t* x;
+    size_t K;
+    tg_value_t* y;
+    size_t L;
+    size_t chunk;
+} tg_gemv_t;
+
+// Task i covers outputs [i * chunk, (i + 1) * chunk).
+static void tensor_gemv_task(void* ctx, size_t task, size_t worker) {
+    (void)worker;
+    tg_gemv_t* g = ctx;
+    size_t l0 = task * g->chunk;
+    size_t n = g->L - l0 < g->chunk ? g->L - l0 : g->chunk;
+    if (g->cs == 1) {
+        for (size_t l = l0; l < l0 + n; l++) {
+            g->y[l] += (tg_value_t)tensor_dot_pairwise(g->mat + l * g->rs, g->x, g->K);
+        }
+    } else {
+        for (size_t k = 0; k < g->K; k++) {
+            tg_simd->axpy(g->y + l0, g->x[k], g->mat + k * g->cs + l0, n);
+        }
+    }
+}
+
+// C[m, :] += u[m * us] * v for rows [i * chunk, (i + 1) * chunk).
+typedef struct {
+    const tg_value_t* u;
+    size_t us;
+    const tg_value_t* v;
+    tg_value_t* c;
+    size_t ldc, M, N;
+    size_t chunk;
+} tg_ger_t;
+
+static void tensor_ger_task(void* ctx, size_t task, size_t worker) {
+    (void)worker;
+    tg_ger_t* g = ctx;
+    size_t m1 = g->M - task * g->chunk < g->chunk ? g->M : (task + 1) * g->chunk;
+    for (size_t m = task * g->chunk; m < m1; m++) {
+        tg_simd->axpy(g->c + m * g->ldc, g->u[m * g->us], g->v, g->N);
+    }
+}
+
+// Copies a strided vector into contiguous scratch; contiguous ones are
+// returned as is.
+static const tg_value_t* tensor_gather(const tg_value_t* x, size_t stride, size_t n, tg_value_t* scratch) {
+    if (stride == 1) {
+        return x;
+    }
+    for (size_t i = 0; i < n; i++) { scratch[i] = x[i * stride]; }
+    return scratch;
+}
+
+static size_t tensor_unit_dim_tasks(size_t n, size_t macs, size_t align, size_t* chunk) {
+    size_t n_tasks = tg_in_parallel || (double)macs < TG_GEMM_PARALLEL_MIN_MACS ? 1 : 2 * tensor_get_num_threads();
+    *chunk = (n + n_tasks - 1) / n_tasks;
+    *chunk = (*chunk + align - 1) / align * align;
+    return (n + *chunk - 1) / *chunk;
+}
+
+// C += op(A) * op(B) where M, N or K is 1 (see tensor_gemm).
+static tg_err_t tensor_gemm_unit_dim(bool trans_a, bool trans_b, size_t M, size_t N, size_t K,
+                                     const tg_value_t* a, size_t lda, const tg_value_t* b, size_t ldb,
+                                     tg_value_t* c, size_t ldc) {
+    if (K == 1) {
+        // Outer product: C[m, n] += op(A)(m, 0) * op(B)(0, n).
+        tg_value_t* scratch = tensor_gemm_scratch(N * sizeof(tg_value_t));
+        if (!scratch) { return ERR_MEMORY_ALLOCATION; }
+        tg_ger_t g = {
+            .u = a, .us = trans_a ? 1 : lda,
+            .v = tensor_gather(b, trans_b ? ldb : 1, N, scratch),
+            .c = c, .ldc = ldc, .M = M, .N = N,
+        };
+        size_t n_tasks = tensor_unit_dim_tasks(M, M * N, 1, &g.chunk);
+        tensor_parallel_for(n_tasks, tensor_get_num_threads(), tensor_ger_task, &g);
+        return SUCCESS;
+    }
+
+    // As y += mat * x over the non-unit output dimension.
+    tg_gemv_t g = { .K = K };
+    const tg_value_t* x;
+    size_t xs, ys;
+    if (M == 1) {
+        g.L = N;
+        g.mat = b;
+        g.rs = trans_b ? ldb : 1;
+        g.cs = trans_b ? 1 : ldb;
+        x = a;
+        xs = trans_a ? lda : 1;
+        ys = 1;
+    } else {
+        g.L = M;
+        g.mat = a;
+        g.rs = trans_a ? 1 : lda;
+        g.cs = trans_a ? lda : 1;
+        x = b;
+        xs = trans_b ? 1 : ldb;
+        ys = ldc;
+    }
+
+    // A strided column of C is summed into scratch and added back.
+    bool strided_y = ys != 1;
+    tg_value_t* scratch = tensor_gemm_scratch((K + (strided_y ? g.L : 0)) * sizeof(tg_value_t));
+    if (!scratch) { return ERR_MEMORY_ALLOCATION; }
+    g.x = tensor_gather(x, xs, K, scratch);
+    g.y = strided_y ? scratch + K : c;
+    if (strided_y) {
+        memset(g.y, 0, g.L * sizeof(tg_value_t));
+    }
+
+    size_t n_tasks = tensor_unit_dim_tasks(g.L, g.L * K, TG_GEMM_NR, &g.chunk);
+    tensor_parallel_for(n_tasks, tensor_get_num_threads(), tensor_gemv_task, &g);
+    if (strided_y) {
+        for (size_t l = 0; l < g.L; l++) { c[l * ldc] += g.y[l]; }
+    }
+    return SUCCESS;
+}
+
+// One KC x NC panel of a GEMM. B is packed once into `b_pack` and shared;
+// tasks are (MC row block, column chunk) pairs that pack their block of A
+// into per-worker scratch, so no two tasks write the same part of C.
+typedef struct {
+    const tg_value_t* a;
+    size_t lda;
+    bool trans_a;
+    const tg_value_t* b;
+    size_t ldb;
+    bool trans_b;
+    tg_value_t* c;
+    size_t ldc;
+
+    size_t M, pc, kc, jc, nc;
+    size_t n_chunks;
+    size_t chunk;
+    tg_value_t* b_pack;
+    tg_value_t* a_packs;
+    size_t a_pack_size;
+} tg_gemm_panel_t;
+
+static void tensor_gemm_pack_b_task(void* ctx, size_t task, size_t worker) {
+    (void)worker;
+    tg_gemm_panel_t* panel = ctx;
+    size_t j0 = task * panel->chunk;
+    size_t n_cols = panel->nc - j0 < panel->chunk ? panel->nc - j0 : panel->chunk;
+    tensor_gemm_pack_b(panel->b, panel->ldb, panel->trans_b, panel->pc, panel->jc + j0,
+                       panel->kc, n_cols, panel->b_pack + j0 * panel->kc);
+}
+
+static void tensor_gemm_block_task(void* ctx, size_t task, size_t worker) {
+    tg_gemm_panel_t* panel = ctx;
+    size_t ic = task / panel->n_chunks * TG_GEMM_MC;
+    size_t j0 = task % panel->n_chunks * panel->chunk;
+    size_t mc = panel->M - ic < TG_GEMM_MC ? panel->M - ic : TG_GEMM_MC;
+    size_t j1 = panel->nc - j0 < panel->chunk ? panel->nc : j0 + panel->chunk;
+    size_t kc = panel->kc;
+
+    tg_value_t* a_pack = panel->a_packs + worker * panel->a_pack_size;
+    tensor_gemm_pack_a(panel->a, panel->lda, panel->trans_a, ic, panel->pc, mc, kc, a_pack);
+
+    tg_value_t tile[TG_GEMM_MR * TG_GEMM_NR];
+    for (size_t jr = j0; jr < j1; jr += TG_GEMM_NR) {
+        size_t n_cols = j1 - jr < TG_GEMM_NR ? j1 - jr : TG_GEMM_NR;
+        for (size_t ir = 0; ir < mc; ir += TG_GEMM_MR) {
+            size_t n_rows = mc - ir < TG_GEMM_MR ? mc - ir : TG_GEMM_MR;
+            tg_simd->gemm_tile(kc, a_pack + ir * kc, panel->b_pack + jr * kc, tile);
+            for (size_t r = 0; r < n_rows; r++) {
+                tg_value_t* c_row = panel->c + (ic + ir + r) * panel->ldc + panel->jc + jr;
+                tg_simd->grad_acc(c_row, tile + r * TG_GEMM_NR, n_cols);
+            }
+        }
+    }
+}
+
+// C = op(A) * op(B), or C += op(A) * op(B) when `accumulate` is set, for
+// row-major matrices where op(X) is X or its transpose. op(A) is M x K,
+// op(B) is K x N and C is M x N; ld* are the row strides as stored.
+//
+// Each KC x NC panel is split into MC row blocks times column chunks across
+// the thread pool: tall-skinny products parallelize over rows, short-wide
+// ones over columns. Every element of C still sums its k blocks in order, so
+// the result does not depend on the thread count.
+static tg_err_t tensor_gemm(bool trans_a, bool trans_b, size_t M, size_t N, size_t K,
+                            const tg_value_t* a, size_t lda, const tg_value_t* b, size_t ldb,
+                            tg_value_t* c, size_t ldc, bool accumulate) {
+    if (!accumulate) {
+        for (size_t i = 0; i < M; i++) { memset(c + i * ldc, 0, N * sizeof(tg_value_t)); }
+    }
+    if (M == 0 || N == 0 || K == 0) {
+        return SUCCESS;
+    }
+    if (M == 1 || N == 1 || K == 1) {
+        return tensor_gemm_unit_dim(trans_a, trans_b, M, N, K, a, lda, b, ldb, c, ldc);
+    }
+
+    bool serial = tg_in_parallel || (double)M * N * K < TG_GEMM_PARALLEL_MIN_MACS;
+    size_t n_threads = serial ? 1 : tensor_get_num_threads();
+    size_t kc_max = K < TG_GEMM_KC ? K : TG_GEMM_KC;
+    size_t mc_max = M < TG_GEMM_MC ? (M + TG_GEMM_MR - 1) / TG_GEMM_MR * TG_GEMM_MR : TG_GEMM_MC;
+    size_t nc_max = N < TG_GEMM_NC ? (N + TG_GEMM_NR - 1) / TG_GEMM_NR * TG_GEMM_NR : TG_GEMM_NC;
+
+    tg_gemm_panel_t panel = {
+        .a = a, .lda = lda, .trans_a = trans_a,
+        .b = b, .ldb = ldb, .trans_b = trans_b,
+        .c = c, .ldc = ldc, .M = M,
+        .a_pack_size = mc_max * kc_max,
+    };
+    panel.b_pack = tensor_gemm_scratch((kc_max * nc_max + n_threads * panel.a_pack_size) * sizeof(tg_value_t));
+    if (!panel.b_pack) {
+        return ERR_MEMORY_ALLOCATION;
+    }
+    panel.a_packs = panel.b_pack + kc_max * nc_max;
+
+    size_t n_row_blocks = (M + TG_GEMM_MC - 1) / TG_GEMM_MC;
+    for (size_t jc = 0; jc < N; jc += TG_GEMM_NC) {
+        size_t nc = N - jc < TG_GEMM_NC ? N - jc : TG_GEMM_NC;
+        size_t n_slivers = (nc + TG_GEMM_NR - 1) / TG_GEMM_NR;
+
+        // Enough column chunks that every thread gets about two tasks.
+        size_t n_chunks = (2 * n_threads + n_row_blocks - 1) / n_row_blocks;
+        n_chunks = n_chunks < n_slivers ? n_chunks : n_slivers;
+        panel.jc = jc;
+        panel.nc = nc;
+        panel.chunk = (n_slivers + n_chunks - 1) / n_chunks * TG_GEMM_NR;
+        panel.n_chunks = (nc + panel.chunk - 1) / panel.chunk;
+
+        for (size_t pc = 0; pc < K; pc += TG_GEMM_KC) {
+            panel.pc = pc;
+            panel.kc = K - pc < TG_GEMM_KC ? K - pc : TG_GEMM_KC;
+            if (n_threads > 1) {
+                tensor_parallel_for(panel.n_chunks, n_threads, tensor_gemm_pack_b_task, &panel);
+                tensor_parallel_for(n_row_blocks * panel.n_chunks, n_threads, tensor_gemm_block_task, &panel);
+            } else {
+                for (size_t task = 0; task < panel.n_chunks; task++) {
+                    tensor_gemm_pack_b_task(&panel, task, 0);
+                }
+                for (size_t task = 0; task < n_row_blocks * panel.n_chunks; task++) {
+                    tensor_gemm_block_task(&panel, task, 0);
+                }
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+// A batch of GEMMs C_i (+)= op(A_i) * op(B_i), where X_i = x + i * x_stride.
+// A zero stride shares that operand across the batch; a zero c_stride
+// accumulates every product into the same C.
+typedef struct {
+    bool trans_a, trans_b;
+    size_t M, N, K;
+    const tg_value_t* a;
+    size_t lda, a_stride;
+    const tg_value_t* b;
+    size_t ldb, b_stride;
+    tg_value_t* c;
+    size_t ldc, c_stride;
+    bool accumulate;
+    tg_err_t err;
+} tg_gemm_batch_t;
+
+static void tensor_gemm_batch_task(void* ctx, size_t i, size_t worker) {
+    (void)worker;
+    tg_gemm_batch_t* g = ctx;
+    tg_err_t err = tensor_gemm(g->trans_a, g->trans_b, g->M, g->N, g->K,
+                               g->a + i * g->a_stride, g->lda, g->b + i * g->b_stride, g->ldb,
+                               g->c + i * g->c_stride, g->ldc, g->accumulate);
+    if (err != SUCCESS) { g->err = err; }
+}
+
+static tg_err_t tensor_gemm_batched(tg_gemm_batch_t* g, size_t batch) {
+    // Stacked operands against a shared one fold into a single GEMM, so the
+    // shared operand is packed once: rows of op(A) when B is shared, or the
+    // contraction when both are stacked along it and C is shared.
+    if (batch > 1 && g->b_stride == 0 && !g->trans_a
+        && g->a_stride == g->M * g->lda && g->c_stride == g->M * g->ldc) {
+        return tensor_gemm(false, g->trans_b, g->M * batch, g->N, g->K,
+                           g->a, g->lda, g->b, g->ldb, g->c, g->ldc, g->accumulate);
+    }
+    if (batch > 1 && g->c_stride == 0 && g->trans_a && !g->trans_b
+        && g->a_stride == g->K * g->lda && g->b_stride == g->K * g->ldb) {
+        return tensor_gemm(true, false, g->M, g->N, g->K * batch,
+                           g->a, g->lda, g->b, g->ldb, g->c, g->ldc, g->accumulate);
+    }
+
+    // With at least one product per thread (or products too small to split)
+    // each runs whole on one thread; otherwise they go one at a time,
+    // parallel inside the GEMM. Products sharing C always run in order.
+    g->err = SUCCESS;
+    bool per_item = batch >= tensor_get_num_threads()
+                 || (double)g->M * g->N * g->K < TG_GEMM_PARALLEL_MIN_MACS;
+    if (g->c_stride != 0 && per_item) {
+        tensor_parallel_for(batch, tensor_get_num_threads(), tensor_gemm_batch_task, g);
+    } else {
+        for (size_t i = 0; i < batch && g->err == SUCCESS; i++) {
+            tensor_gemm_batch_task(g, i, 0);
+        }
+    }
+    return g->err;
+}
+
+// ==============================
+//          Step arena
+// ==============================
+#define TG_ARENA_CHUNK_HEADER TG_ALIGN_UP(sizeof(tg_arena_chunk_t), TG_ALIGNMENT)
+
+static tg_arena_chunk_t* tensor_arena_chunk_new(size_t capacity) {
+    tg_arena_chunk_t* chunk = tensor_aligned_alloc(TG_ARENA_CHUNK_HEADER + capacity);
+    if (!chunk) { return NULL; }
+    *chunk = (tg_arena_chunk_t){ .next = NULL, .capacity = capacity, .used = 0 };
+    return chunk;
+}
+
+tg_err_t tensor_arena_init(tg_arena_t* arena, size_t chunk_size) {
+    assert(arena != NULL);
+    assert(chunk_size > 0);
+
+    *arena = (tg_arena_t){ .chunk_size = chunk_size };
+    arena->head = tensor_arena_chunk_new(chunk_size);
+    if (!arena->head) { return ERR_MEMORY_ALLOCATION; }
+    arena->current = arena->head;
+    return SUCCESS;
+}
+
+void tensor_arena_begin(tg_arena_t* arena) {
+    assert(arena != NULL);
+    assert(tg_active_arena == NULL && "arenas do not nest");
+    tg_active_arena = arena;
+}
+
+void tensor_arena_end(void) {
+    tg_active_arena = NULL;
+}
+
+static void* tensor_arena_alloc(tg_arena_t* arena, size_t size, bool zeroed) {
+    size = TG_ALIGN_UP(size, TG_ALIGNMENT);
+
+    tg_arena_chunk_t* chunk = arena->current;
+    while (chunk->used + size > chunk->capacity) {
+        if (!chunk->next) {
+            size_t capacity = size > arena->chunk_size ? size : arena->chunk_size;
+            chunk->next = tensor_arena_chunk_new(capacity);
+            if (!chunk->next) { return NULL; }
+        }
+        // Chunks past `current` still hold offsets from a previous step.
+        chunk = chunk->next;
+        chunk->used = 0;
+    }
+    arena->current = chunk;
+
+    void* ptr = (unsigned char*)chunk + TG_ARENA_CHUNK_HEADER + chunk->used;
+    chunk->used += size;
+    if (zeroed) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+// O(1): rewinds to the first chunk. Later chunks are rewound lazily the next
+// time the bump pointer reaches them.
+void tensor_arena_reset(tg_arena_t* arena) {
+    assert(arena != NULL);
+    arena->current = arena->head;
+    arena->head->used = 0;
+}
+
+void tensor_arena_free(tg_arena_t* arena) {
+    assert(arena != NULL);
+
+    tg_arena_chunk_t* chunk = arena->head;
+    while (chunk) {
+        tg_arena_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    *arena = (tg_arena_t){0};
+}
+
+// ==============================
+//         Tensor pool
+// ==============================
+typedef union tg_pool_block_t tg_pool_block_t;
+
+// Header in front of every pooled block. `next` links free blocks; `pool`
+// and `size_class` let tensor_release find the list without an active pool.
+// It is padded to TG_ALIGNMENT so the block after it stays aligned.
+union tg_pool_block_t {
+    struct {
+        tg_pool_t* pool;
+        tg_pool_block_t* next;
+        size_t size_class;
+    } info;
+    alignas(TG_ALIGNMENT) unsigned char align[TG_ALIGNMENT];
+};
+
+void tensor_pool_init(tg_pool_t* pool, bool lazy_zero) {
+    assert(pool != NULL);
+    *pool = (tg_pool_t){ .lazy_zero = lazy_zero };
+}
+
+void tensor_pool_begin(tg_pool_t* pool) {
+    assert(pool != NULL);
+    assert(tg_active_pool == NULL && "pools do not nest");
+    tg_active_pool = pool;
+}
+
+void tensor_pool_end(void) {
+    tg_active_pool = NULL;
+}
+
+static size_t tensor_pool_size_class(size_t size) {
+    size_t size_class = 0;
+    size_t block_size = TG_POOL_MIN_BLOCK;
+    while (block_size < size) {
+        block_size <<= 1;
+        size_class += 1;
+    }
+    assert(size_class < TG_POOL_N_CLASSES);
+    return size_class;
+}
+
+static void* tensor_pool_alloc(tg_pool_t* pool, size_t size, bool zeroed) {
+    size_t size_class = tensor_pool_size_class(size);
+    tg_pool_block_t* block = pool->free_lists[size_class];
+
+    if (block) {
+        pool->hits += 1;
+        pool->free_lists[size_class] = block->info.next;
+        if (zeroed || !pool->lazy_zero) {
+            memset(block + 1, 0, size);
+        }
+    } else {
+        pool->misses += 1;
+        size_t block_size = (size_t)TG_POOL_MIN_BLOCK << size_class;
+        block = tensor_aligned_alloc(sizeof(tg_pool_block_t) + block_size);
+        if (!block) { return NULL; }
+        memset(block + 1, 0, size);
+    }
+
+    block->info.pool = pool;
+    block->info.size_class = size_class;
+    block->info.next = NULL;
+    return block + 1;
+}
+
+static tg_pool_t* tensor_pool_of(void* ptr) {
+    return ((tg_pool_block_t*)ptr - 1)->info.pool;
+}
+
+static void tensor_pool_release(void* ptr) {
+    tg_pool_block_t* block = (tg_pool_block_t*)ptr - 1;
+    tg_pool_t* pool = block->info.pool;
+
+    block->info.next = pool->free_lists[block->info.size_class];
+    pool->free_lists[block->info.size_class] = block;
+}
+
+// Returns every recycled block to the system. Blocks still owned by live
+// tensors are not tracked and must be released before this is called.
+void tensor_pool_free(tg_pool_t* pool) {
+    assert(pool != NULL);
+
+    for (size_t i = 0; i < TG_POOL_N_CLASSES; i++) {
+        tg_pool_block_t* block = pool->free_lists[i];
+        while (block) {
+            tg_pool_block_t* next = block->info.next;
+            free(block);
+            block = next;
+        }
+        pool->free_lists[i] = NULL;
+    }
+}
+
+void tensor_no_grad_begin(void) {
+    tg_no_grad_depth += 1;
+}
+
+void tensor_no_grad_end(void) {
+    assert(tg_no_grad_depth > 0);
+    tg_no_grad_depth -= 1;
+}
+
+bool tensor_grad_enabled(void) {
+    return tg_no_grad_depth == 0;
+}
+
+
+// `storage` holds 2 * n_dims entries for shapes too large to stay inline;
+// when it is NULL such shapes fall back to the heap.
+static tg_err_t tensor_shape_init_with(size_t dims[], size_t n_dims, size_t* storage,
+                                       tg_tensor_shape_t* shape) {
+    assert(dims != NULL);
+    assert(n_dims > 0);
+    if (!shape) {return ERR_MEMORY_ALLOCATION; }
+
+    shape->n_dimensions = n_dims;
+
+    if (n_dims <= TG_SHAPE_INLINE_DIMS) {
+        shape->dimensions = shape->inline_dimensions;
+        shape->strides = shape->inline_strides;
+    } else {
+        if (!storage) {
+            storage = calloc(2 * n_dims, sizeof(size_t));
+            if (!storage) {return ERR_MEMORY_ALLOCATION; }
+        }
+        shape->dimensions = storage;
+        shape->strides = storage + n_dims;
+    }
+
+    memcpy((void*)shape->dimensions, (const void*) dims, sizeof(size_t)*n_dims);
+    assert(*dims == *shape->dimensions);
+
+    for(size_t i = 0; i < shape->n_dimensions; i++) {
+        size_t stride_length = 1;
+        for (size_t j = i + 1; j < shape->n_dimensions; j++) {
+            stride_length *= dims[j];
+        }
+        shape->strides[i] = stride_length;
+    }
+    return SUCCESS;
+}
+
+tg_err_t tensor_shape_init(size_t dims[], size_t n_dims, tg_tensor_shape_t* shape) {
+    return tensor_shape_init_with(dims, n_dims, NULL, shape);
+}
+
+// Only for shapes created with tensor_shape_init; a tensor's shape is part of
+// the tensor's own allocation.
+void tensor_shape_free(tg_tensor_shape_t* shape) {
+    assert(shape != NULL);
+    if (shape->dimensions != shape->inline_dimensions) {
+        free(shape->dimensions);
+    }
+    shape->dimensions = NULL;
+    shape->strides = NULL;
+    shape->n_dimensions = 0;
+}
+
+// Zeroed memory from the allocator `owner` came from, for buffers attached
+// to a tensor after it was created.
+static void* tensor_alloc_for(tg_tensor_t* owner, size_t size) {
+    switch (owner->alloc) {
+        case TG_ALLOC_HEAP:
+            return tensor_aligned_calloc(size);
+        case TG_ALLOC_ARENA:
+            return tensor_arena_alloc(owner->arena, size, true);
+        case TG_ALLOC_POOL:
+            return tensor_pool_alloc(tensor_pool_of(owner), size, true);
+    }
+    UNREACHABLE();
+    return NULL;
+}
+
+static void tensor_release_all(tg_tensor_t* tensor) {
+    tensor_release(tensor->alloc, tensor->grads);
+    tensor_release(tensor->alloc, tensor->lazy_expr);
+    // A block that holds its own storage goes with the storage's last reference.
+    tg_storage_t* storage = tensor->storage;
+    if (storage && storage->block == tensor) {
+        tensor_storage_release(storage);
+        return;
+    }
+    if (tensor->alloc != TG_ALLOC_ARENA) {
+        tensor_storage_release(storage);
+    }
+    tensor_release(tensor->alloc, tensor);
+}
+
+void tensor_free(tg_tensor_t* tensor) {
+    assert(tensor != NULL);
+    tensor_release_all(tensor);
+}
+
+void tensor_set_requires_grad(tg_tensor_t* tensor, bool requires_grad) {
+    assert(tensor != NULL);
+    tensor->requires_grad = requires_grad;
+}
+
+// Allocates the zeroed grads buffer from the same allocator as the tensor.
+tg_err_t tensor_grads_ensure(tg_tensor_t* tensor) {
+    assert(tensor != NULL);
+    if (tensor->grads) {
+        return SUCCESS;
+    }
+
+    tensor->grads = tensor_alloc_for(tensor, tensor->n_elements * sizeof(tg_value_t));
+    return tensor->grads ? SUCCESS : ERR_MEMORY_ALLOCATION;
+}
+
+// Returns the buffer to accumulate dL/d(tensor) into, or NULL when the
+// tensor does not require grad.
+static tg_err_t tensor_grads_acquire(tg_tensor_t* tensor, tg_value_t** grads) {
+    *grads = NULL;
+    if (!tensor->requires_grad) {
+        return SUCCESS;
+    }
+    tg_err_t err = tensor_grads_ensure(tensor);
+    *grads = tensor->grads;
+    return err;
+}
+
+
+static tg_err_t tensor_graph_scratch_reserve(void** buffer, size_t* capacity,
+                                             size_t needed, size_t element_size) {
+    if (needed <= *capacity) {
+        return SUCCESS;
+    }
+    size_t new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    void* grown = realloc(*buffer, new_capacity * element_size);
+    if (!grown) { return ERR_MEMORY_ALLOCATION; }
+    *buffer = grown;
+    *capacity = new_capacity;
+#ifndef TG_NO_THREADS
+    tensor_scratch_register(&tg_graph_scratch_key, &tg_graph_scratch);
+#endif
+    return SUCCESS;
+}
+
+static tg_err_t tensor_graph_scratch_push(size_t* n_frames, tg_tensor_t* tensor) {
+    tg_err_t err = tensor_graph_scratch_reserve((void**)&tg_graph_scratch.frames,
+                                                &tg_graph_scratch.frames_capacity,
+                                                *n_frames + 1,
+                                                sizeof(tg_graph_frame_t));
+    if (err != SUCCESS) { return err; }
+
+    tg_graph_scratch.frames[*n_frames] = (tg_graph_frame_t){ .tensor = tensor, .next_input = 0 };
+    *n_frames += 1;
+    return SUCCESS;
+}
+
+void tensor_graph_scratch_release(void) {
+    tensor_graph_scratch_free(&tg_graph_scratch);
+}
+
+void tensor_free_recursive(tg_tensor_t* tensor) {
+    assert(tensor != NULL);
+
+    size_t n_frames = 0;
+    UNWRAP(tensor_graph_scratch_push(&n_frames, tensor));
+
+    while (n_frames > 0) {
+        tg_tensor_t* current = tg_graph_scratch.frames[--n_frames].tensor;
+
+        if(current->ref_count > 1) {
+            current->ref_count -= 1;
+            continue;
+        }
+
+        // Arena tensors hold no references and are released by the arena.
+        if(current->alloc == TG_ALLOC_ARENA) {
+            continue;
+        }
+
+        for(size_t i = 0; i < current->n_input_tensors; ++i) {
+            UNWRAP(tensor_graph_scratch_push(&n_frames, current->input_tensors[i]));
+        }
+        tensor_release_all(current);
+    }
+}
+
+// Builds a topological order of every tensor reachable from `root` through
+// `input_tensors`: inputs always come before the tensors computed from them,
+// and each node appears exactly once no matter how many consumers it has.
+// This is an iterative post-order DFS over the scratch worklist; the returned
+// array is owned by the scratch buffer and is valid until the next traversal.
+tg_err_t tensor_graph_topo_order(tg_tensor_t* root, tg_tensor_t*** order, size_t* n_order) {
+    assert(root != NULL);
+    assert(order != NULL);
+    assert(n_order != NULL);
+
+    size_t epoch = atomic_fetch_add(&tg_graph_epoch, 1) + 1;
+    tg_graph_scratch.n_order = 0;
+
+    size_t n_frames = 0;
+    tg_err_t err = tensor_graph_scratch_push(&n_frames, root);
+    root->graph_mark = epoch;
+
+    while (err == SUCCESS && n_frames > 0) {
+        tg_graph_frame_t* frame = &tg_graph_scratch.frames[n_frames - 1];
+        tg_tensor_t* current = frame->tensor;
+
+        if (frame->next_input < current->n_input_tensors) {
+            tg_tensor_t* input = current->input_tensors[frame->next_input++];
+            if (input->graph_mark != epoch) {
+                input->graph_mark = epoch;
+                err = tensor_graph_scratch_push(&n_frames, input);
+            }
+            continue;
+        }
+
+        n_frames -= 1;
+        err = tensor_graph_scratch_reserve((void**)&tg_graph_scratch.order,
+                                           &tg_graph_scratch.order_capacity,
+                                           tg_graph_scratch.n_order + 1,
+                                           sizeof(tg_tensor_t*));
+        if (err == SUCCESS) {
+            tg_graph_scratch.order[tg_graph_scratch.n_order++] = current;
+        }
+    }
+
+    if (err != SUCCESS) {
+        tg_graph_scratch.n_order = 0;
+    }
+    *order = tg_graph_scratch.order;
+    *n_order = tg_graph_scratch.n_order;
+    return err;
+}
+
+// Seeds dL/dL = 1 and runs every node's local gradient kernel exactly once,
+// in reverse topological order. By the time a node's kernel runs, all of its
+// consumers have already accumulated into its grads, so shared subgraphs see
+// their complete gradient and are never revisited.
+tg_err_t tensor_backward_pass(tg_tensor_t* tensor) {
+    assert(tensor != NULL);
+    assert(tensor->requires_grad && "backward from a tensor that does not require grad");
+
+    tg_tensor_t** order = NULL;
+    size_t n_order = 0;
+    tg_err_t err = tensor_graph_topo_order(tensor, &order, &n_order);
+    if (err != SUCCESS) { return err; }
+
+    TENSOR_GRADS_SET(tensor, 1.0);
+    for (size_t i = n_order; i-- > 0;) {
+        tg_tensor_t* node = order[i];
+        if (!node->backward) { continue; }
+        err = tensor_check_saved_versions(node->op, node, node->input_tensors,
+                                          node->saved_versions, node->n_input_tensors);
+        if (err != SUCCESS) { break; }
+        err = node->backward(node);
+        if (err != SUCCESS) { break; }
+    }
+
+    return err;
+}
+
+
+tg_err_t tensor_scalar_add(tg_tensor_t* tensor, tg_value_t scalar) {
+      TENSOR_SCALAR_OP(tensor, scalar, scalar_add);
+      return SUCCESS;
+}
+tg_err_t tensor_scalar_sub(tg_tensor_t* tensor, tg_value_t scalar) {
+      TENSOR_SCALAR_OP(tensor, scalar, scalar_sub);
+      return SUCCESS;
+}
+tg_err_t tensor_scalar_mul(tg_tensor_t* tensor, tg_value_t scalar) {
+      TENSOR_SCALAR_OP(tensor, scalar, scalar_mul);
+      return SUCCESS;
+}
+// Multiplies by 1/scalar, which may differ from true division in the last
+// bit (it is exact when scalar is a power of two).
+tg_err_t tensor_scalar_div(tg_tensor_t* tensor, tg_value_t scalar) {
+      TENSOR_SCALAR_OP(tensor, 1 / scalar, scalar_mul);
+      return SUCCESS;
+}
+
+tg_err_t tensor_sqrt(tg_tensor_t* tensor) {
+    TENSOR_UNARY_OP(tensor, sqrt);
+    return SUCCESS;
+}
+
+tg_err_t tensor_abs(tg_tensor_t* tensor) {
+    TENSOR_UNARY_OP(tensor, abs);
+    return SUCCESS;
+}
+
+tg_err_t tensor_create_graph(tg_tensor_t* tensor, \
+                              tg_tensor_t* a, \
+                              tg_tensor_t* b, \
+                              enum tg_backward_op op) {
+    assert(tensor != NULL);
+    assert(a != NULL);
+
+    // Outputs only require grad if one of their inputs does; constants and
+    // frozen subgraphs get no graph edges at all. Unary ops pass b == NULL.
+    tensor->requires_grad = tensor_grad_enabled() && (a->requires_grad || (b && b->requires_grad));
+    if (!tensor->requires_grad) {
+        return SUCCESS;
+    }
+
+    if (tg_active_tape) {
+        return tensor_tape_record(tg_active_tape, op, tensor, a, b);
+    }
+
+    // During backward pass:
+    //   - Calling backward(C) computes dL/dA and dL/dB and accumulates
+    //     them into A and B, without recursing any further
+    //   - tensor_backward_pass runs backward(...) for every node once, in
+    //     reverse topological order
+    //
+    // This allows the loss gradient to flow backward through the entire graph:
+    //   Loss -> ... -> C -> A, B -> ... -> parameters
+    //
+    tensor->n_input_tensors = b ? 2 : 1;
+    tensor->input_tensors = tensor->inline_inputs;
+    tensor->input_tensors[0] = a;
+    tensor->saved_versions[0] = tensor_version(a);
+    if (b) {
+        tensor->input_tensors[1] = b;
+        tensor->saved_versions[1] = tensor_version(b);
+    }
+    tensor->op = op;
+
+    if (tensor->alloc != TG_ALLOC_ARENA) {
+        a->ref_count += 1;
+        if (b) { b->ref_count += 1; }
+    }
+
+    switch (op) {
+        case TG_BOP_EL_ADD:
+            // Addition:
+            // d(A+B)/dA = 1,  d(A+B)/dB = 1
+            tensor->backward = tensor_backward_el_add;
+            break;
+        case TG_BOP_EL_SUB:
+            // Subtraction:
+            // d(A-B)/dA = 1,  d(A-B)/dB = -1
+            tensor->backward = tensor_backward_el_sub;
+            break;
+        case TG_BOP_EL_MUL:
+            // Multiplication:
+            // d(A*B)/dA = B,  d(A*B)/dB = A
+            tensor->backward = tensor_backward_el_mul;
+            break;
+        case TG_BOP_EL_DIV:
+            // Division:
+            // d(A/B)/dA = 1/B, d(A/B)/dB = -A/B²
+            tensor->backward = tensor_backward_el_div;
+            break;
+        case TG_BOP_MAT_MUL:
+            // Matrix multiplication (C = A·B):
+            // dL/dA = dL/dC·Bᵀ, dL/dB = Aᵀ·dL/dC
+            tensor->backward = tensor_backward_mat_mul;
+            break;
+        case TG_BOP_RELU:
+            // d relu(A)/dA = 1 where A > 0, else 0
+        case TG_BOP_SIGMOID:
+            // d sigmoid(A)/dA = C·(1 - C)
+        case TG_BOP_TANH:
+            // d tanh(A)/dA = 1 - C²
+        case TG_BOP_EXP:
+            // d exp(A)/dA = C
+        case TG_BOP_LOG:
+            // d log(A)/dA = 1/A
+        case TG_BOP_VIEW:
+            // dL/dA = dL/dC scattered into the viewed elements of A
+        case TG_BOP_COPY:
+            // dL/dA = dL/dC
+            assert(b == NULL);
+            tensor->backward = tensor_backward_unary;
+            break;
+        case TG_BOP_SOFTMAX_CROSS_ENTROPY:
+            // Mean over R rows of -log softmax(A)[target]:
+            // dL/dA = (softmax(A) - onehot(B)) / R, nothing flows into B
+            tensor->backward = tensor_backward_softmax_cross_entropy;
+            break;
+        case TG_BOP_SUM_REDUCTION:
+            // Sum over the axes reduced to size 1:
+            // dL/dA = dL/dC broadcast back over those axes
+        case TG_BOP_MEAN_REDUCTION:
+            // Mean: the same, scaled by 1/(number of reduced elements)
+            assert(b == NULL);
+            tensor->backward = tensor_backward_reduction;
+            break;
+        case TG_BOP_FUSED_ELEMENTWISE:
+            // Fused nodes wire up their leaves in tensor_lazy_binary.
+            UNREACHABLE();
+        default:
+            TENSOR_DESTROY(tensor);
+            UNREACHABLE();
+    }
+
+    return SUCCESS;
+}
+
+// Local gradient kernels: accumulate dL/dA and dL/dB from dL/dC = C->grads.
+// They are shared by the node graph (through tensor->backward) and the tape
+// (through tg_bop_grad_kernels). Inputs that do not require grad are skipped,
+// and the others get their grads buffer on first accumulation.
+#define TG_GRAD_KERNEL_PROLOGUE(C, A, B, dA, dB) \
+    if (!(C)->grads) { return SUCCESS; } \
+    tg_value_t* dA = NULL; \
+    tg_value_t* dB = NULL; \
+    do { \
+        tg_err_t err = tensor_grads_acquire((A), &dA); \
+        if (err == SUCCESS) { err = tensor_grads_acquire((B), &dB); } \
+        if (err != SUCCESS) { return err; } \
+    } while (0)
+
+static tg_err_t tensor_grad_el_add(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    TG_GRAD_KERNEL_PROLOGUE(C, A, B, dA, dB);
+    if (!tensor_flat_pair(A, B)) { return tensor_grad_el_broadcast(C, A, B, dA, dB, TG_BOP_EL_ADD); }
+    if (dA) { tg_simd->grad_acc(dA, C->grads, C->n_elements); }
+    if (dB) { tg_simd->grad_acc(dB, C->grads, C->n_elements); }
+    return SUCCESS;
+}
+
+static tg_err_t tensor_grad_el_sub(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    TG_GRAD_KERNEL_PROLOGUE(C, A, B, dA, dB);
+    if (!tensor_flat_pair(A, B)) { return tensor_grad_el_broadcast(C, A, B, dA, dB, TG_BOP_EL_SUB); }
+    if (dA) { tg_simd->grad_acc(dA, C->grads, C->n_elements); }
+    if (dB) { tg_simd->grad_acc_neg(dB, C->grads, C->n_elements); }
+    return SUCCESS;
+}
+
+static tg_err_t tensor_grad_el_mul(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    TG_GRAD_KERNEL_PROLOGUE(C, A, B, dA, dB);
+    if (!tensor_flat_pair(A, B)) { return tensor_grad_el_broadcast(C, A, B, dA, dB, TG_BOP_EL_MUL); }
+    if (dA) { tg_simd->grad_mul(dA, C->grads, B->vals, C->n_elements); }
+    if (dB) { tg_simd->grad_mul(dB, C->grads, A->vals, C->n_elements); }
+    return SUCCESS;
+}
+
+static tg_err_t tensor_grad_el_div(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    TG_GRAD_KERNEL_PROLOGUE(C, A, B, dA, dB);
+    if (!tensor_flat_pair(A, B)) { return tensor_grad_el_broadcast(C, A, B, dA, dB, TG_BOP_EL_DIV); }
+    if (dA) { tg_simd->grad_div_lhs(dA, C->grads, B->vals, C->n_elements); }
+    if (dB) { tg_simd->grad_div_rhs(dB, C->grads, A->vals, B->vals, C->n_elements); }
+    return SUCCESS;
+}
+
+// Per batch item dA_i += dC_i·B_iᵀ and dB_i += A_iᵀ·dC_i. A shared operand
+// has a zero stride, so its gradient sums over the whole batch.
+static tg_err_t tensor_grad_mat_mul(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    TG_GRAD_KERNEL_PROLOGUE(C, A, B, dA, dB);
+    tg_matmul_dims_t d = tensor_matmul_dims(A, B);
+    size_t c_stride = d.M * d.N;
+
+    tg_err_t err = SUCCESS;
+    if (dA) {
+        const tg_value_t* b_vals = NULL;
+        tg_value_t* scratch = NULL;
+        err = tensor_dense_vals(B, &b_vals, &scratch);
+        if (err != SUCCESS) { return err; }
+        tg_gemm_batch_t g = {
+            .trans_b = true, .M = d.M, .N = d.K, .K = d.N,
+            .a = C->grads, .lda = d.N, .a_stride = c_stride,
+            .b = b_vals, .ldb = d.N, .b_stride = d.b_stride,
+            .c = dA, .ldc = d.K, .c_stride = d.a_stride, .accumulate = true,
+        };
+        err = tensor_gemm_batched(&g, d.batch);
+        free(scratch);
+    }
+    if (dB && err == SUCCESS) {
+        const tg_value_t* a_vals = NULL;
+        tg_value_t* scratch = NULL;
+        err = tensor_dense_vals(A, &a_vals, &scratch);
+        if (err != SUCCESS) { return err; }
+        tg_gemm_batch_t g = {
+            .trans_a = true, .M = d.K, .N = d.N, .K = d.M,
+            .a = a_vals, .lda = d.K, .a_stride = d.a_stride,
+            .b = C->grads, .ldb = d.N, .b_stride = c_stride,
+            .c = dB, .ldc = d.N, .c_stride = d.b_stride, .accumulate = true,
+        };
+        err = tensor_gemm_batched(&g, d.batch);
+        free(scratch);
+    }
+    return err;
+}
+
+// Unary kernels take B == NULL.
+#define TG_UNARY_GRAD_KERNEL_PROLOGUE(C, A, dA) \
+    if (!(C)->grads) { return SUCCESS; } \
+    tg_value_t* dA = NULL; \
+    do { \
+        tg_err_t err = tensor_grads_acquire((A), &dA); \
+        if (err != SUCCESS) { return err; } \
+        if (!dA) { return SUCCESS; } \
+    } while (0)
+
+static tg_err_t tensor_grad_relu(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    (void)B;
+    TG_UNARY_GRAD_KERNEL_PROLOGUE(C, A, dA);
+    const tg_value_t* a = NULL;
+    tg_value_t* scratch = NULL;
+    tg_err_t err = tensor_dense_vals(A, &a, &scratch);
+    if (err != SUCCESS) { return err; }
+    tg_simd->grad_relu(dA, C->grads, a, C->n_elements);
+    free(scratch);
+    return SUCCESS;
+}
+
+static tg_err_t tensor_grad_sigmoid(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    (void)B;
+    TG_UNARY_GRAD_KERNEL_PROLOGUE(C, A, dA);
+    tg_simd->grad_sigmoid(dA, C->grads, C->vals, C->n_elements);
+    return SUCCESS;
+}
+
+static tg_err_t tensor_grad_tanh(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    (void)B;
+    TG_UNARY_GRAD_KERNEL_PROLOGUE(C, A, dA);
+    tg_simd->grad_tanh(dA, C->grads, C->vals, C->n_elements);
+    return SUCCESS;
+}
+
+// d(exp A)/dA = C
+static tg_err_t tensor_grad_exp(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    (void)B;
+    TG_UNARY_GRAD_KERNEL_PROLOGUE(C, A, dA);
+    tg_simd->grad_mul(dA, C->grads, C->vals, C->n_elements);
+    return SUCCESS;
+}
+
+// d(log A)/dA = 1/A
+static tg_err_t tensor_grad_log(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    (void)B;
+    TG_UNARY_GRAD_KERNEL_PROLOGUE(C, A, dA);
+    const tg_value_t* a = NULL;
+    tg_value_t* scratch = NULL;
+    tg_err_t err = tensor_dense_vals(A, &a, &scratch);
+    if (err != SUCCESS) { return err; }
+    tg_simd->grad_div_lhs(dA, C->grads, a, C->n_elements);
+    free(scratch);
+    return SUCCESS;
+}
+
+static tg_err_t (*const tg_bop_grad_kernels[])(tg_tensor_t*, tg_tensor_t*, tg_tensor_t*) = {
+    [TG_BOP_EL_ADD] = tensor_grad_el_add,
+    [TG_BOP_EL_SUB] = tensor_grad_el_sub,
+    [TG_BOP_EL_MUL] = tensor_grad_el_mul,
+    [TG_BOP_EL_DIV] = tensor_grad_el_div,
+    [TG_BOP_MAT_MUL] = tensor_grad_mat_mul,
+    [TG_BOP_SUM_REDUCTION] = tensor_grad_sum,
+    [TG_BOP_MEAN_REDUCTION] = tensor_grad_mean,
+    [TG_BOP_FUSED_ELEMENTWISE] = NULL,
+    [TG_BOP_RELU] = tensor_grad_relu,
+    [TG_BOP_SIGMOID] = tensor_grad_sigmoid,
+    [TG_BOP_TANH] = tensor_grad_tanh,
+    [TG_BOP_EXP] = tensor_grad_exp,
+    [TG_BOP_LOG] = tensor_grad_log,
+    [TG_BOP_SOFTMAX_CROSS_ENTROPY] = tensor_grad_softmax_cross_entropy,
+    [TG_BOP_VIEW] = tensor_grad_view,
+    [TG_BOP_COPY] = tensor_grad_copy,
+};
+#define TG_BOP_COUNT (sizeof(tg_bop_grad_kernels) / sizeof(tg_bop_grad_kernels[0]))
+
+// Whether an op's gradient reads its inputs' values, i.e. whether
+// overwriting an input in place before backward changes the result.
+static const bool tg_bop_saves_inputs[] = {
+    [TG_BOP_EL_ADD] = false,
+    [TG_BOP_EL_SUB] = false,
+    [TG_BOP_EL_MUL] = true,
+    [TG_BOP_EL_DIV] = true,
+    [TG_BOP_MAT_MUL] = true,
+    [TG_BOP_SUM_REDUCTION] = false,
+    [TG_BOP_MEAN_REDUCTION] = false,
+    // Checked by tensor_backward_fused against the expression's leaves.
+    [TG_BOP_FUSED_ELEMENTWISE] = false,
+    [TG_BOP_RELU] = true,
+    [TG_BOP_SIGMOID] = false,
+    [TG_BOP_TANH] = false,
+    [TG_BOP_EXP] = false,
+    [TG_BOP_LOG] = true,
+    [TG_BOP_SOFTMAX_CROSS_ENTROPY] = true,
+    [TG_BOP_VIEW] = false,
+    [TG_BOP_COPY] = false,
+};
+
+// Whether an op's gradient reads its own output's values. Outputs start at
+// version 0, so any in-place write to one shows up as a non-zero version.
+static const bool tg_bop_saves_output[] = {
+    [TG_BOP_SIGMOID] = true,
+    [TG_BOP_TANH] = true,
+    [TG_BOP_EXP] = true,
+};
+
+static tg_err_t tensor_check_saved_versions(enum tg_backward_op op,
+                                            tg_tensor_t* output,
+                                            tg_tensor_t* const inputs[],
+                                            const size_t versions[],
+                                            size_t n_inputs) {
+    if ((size_t)op < sizeof(tg_bop_saves_output) / sizeof(tg_bop_saves_output[0])
+        && tg_bop_saves_output[op] && tensor_version(output) != 0) {
+        return ERR_SAVED_TENSOR_MODIFIED;
+    }
+    if (!tg_bop_saves_inputs[op]) {
+        return SUCCESS;
+    }
+    for (size_t i = 0; i < n_inputs; i++) {
+        if (inputs[i] && tensor_version(inputs[i]) != versions[i]) {
+            return ERR_SAVED_TENSOR_MODIFIED;
+        }
+    }
+    return SUCCESS;
+}
+
+tg_err_t  tensor_backward_el_add(tg_tensor_t* tensor) {
+    if(tensor->n_input_tensors == 0) {
+        return SUCCESS;
+    }
+
+    assert(tensor->n_input_tensors == 2);
+    assert(tensor->input_tensors[0] != NULL);
+    assert(tensor->input_tensors[1] != NULL);
+
+    return tensor_grad_el_add(tensor, tensor->input_tensors[0], tensor->input_tensors[1]);
+}
+
+tg_err_t tensor_backward_el_sub(tg_tensor_t* tensor) {
+    if(tensor->n_input_tensors == 0) {
+        return SUCCESS;
+    }
+    assert(tensor->n_input_tensors == 2);
+    assert(tensor->input_tensors[0] != NULL);
+    assert(tensor->input_tensors[1] != NULL);
+
+    return tensor_grad_el_sub(tensor, tensor->input_tensors[0], tensor->input_tensors[1]);
 }
 
 tg_err_t tensor_backward_el_mul(tg_tensor_t* tensor) {
-    assert(tensor->grads != NULL);
+    if(tensor->n_input_tensors == 0) {
+        return SUCCESS;
+    }
+
+    assert(tensor->n_input_tensors == 2);
+    assert(tensor->input_tensors[0] != NULL);
+    assert(tensor->input_tensors[1] != NULL);
+
+    return tensor_grad_el_mul(tensor, tensor->input_tensors[0], tensor->input_tensors[1]);
+}
+
+tg_err_t tensor_backward_el_div(tg_tensor_t* tensor) {
+    if(tensor->n_input_tensors == 0) {
+        return SUCCESS;
+    }
+
+    assert(tensor->n_input_tensors == 2);
+    assert(tensor->input_tensors[0] != NULL);
+    assert(tensor->input_tensors[1] != NULL);
+
+    return tensor_grad_el_div(tensor, tensor->input_tensors[0], tensor->input_tensors[1]);
+}
+
+tg_err_t tensor_backward_mat_mul(tg_tensor_t* tensor) {
+    if(tensor->n_input_tensors == 0) {
+        return SUCCESS;
+    }
+
+    assert(tensor->n_input_tensors == 2);
+    assert(tensor->input_tensors[0] != NULL);
+    assert(tensor->input_tensors[1] != NULL);
+
+    return tensor_grad_mat_mul(tensor, tensor->input_tensors[0], tensor->input_tensors[1]);
+}
+
+// Shared by the single-input ops (activations, views); the op picks the kernel.
+tg_err_t tensor_backward_unary(tg_tensor_t* tensor) {
+    if(tensor->n_input_tensors == 0) {
+        return SUCCESS;
+    }
+
+    assert(tensor->n_input_tensors == 1);
+    assert(tensor->input_tensors[0] != NULL);
+    assert((size_t)tensor->op < TG_BOP_COUNT && tg_bop_grad_kernels[tensor->op]);
+
+    return tg_bop_grad_kernels[tensor->op](tensor, tensor->input_tensors[0], NULL);
+}
+
+// ==============================
+//         Autograd tape
+// ==============================
+tg_err_t tensor_tape_init(tg_tape_t* tape, size_t capacity) {
+    assert(tape != NULL);
+
+    *tape = (tg_tape_t){0};
+    if (capacity == 0) {
+        return SUCCESS;
+    }
+    tape->records = malloc(capacity * sizeof(tg_tape_record_t));
+    if (!tape->records) { return ERR_MEMORY_ALLOCATION; }
+    tape->capacity = capacity;
+    return SUCCESS;
+}
+
+void tensor_tape_begin(tg_tape_t* tape) {
+    assert(tape != NULL);
+    assert(tg_active_tape == NULL && "tapes do not nest");
+    tg_active_tape = tape;
+}
+
+void tensor_tape_end(void) {
+    tg_active_tape = NULL;
+}
+
+tg_err_t tensor_tape_record(tg_tape_t* tape, enum tg_backward_op op,
+                            tg_tensor_t* output, tg_tensor_t* a, tg_tensor_t* b) {
+    assert(tape != NULL);
+    assert(output != NULL);
+
+    if (tape->n_records == tape->capacity) {
+        size_t new_capacity = tape->capacity ? tape->capacity * 2 : 64;
+        tg_tape_record_t* grown = realloc(tape->records, new_capacity * sizeof(tg_tape_record_t));
+        if (!grown) { return ERR_MEMORY_ALLOCATION; }
+        tape->records = grown;
+        tape->capacity = new_capacity;
+    }
+
+    tape->records[tape->n_records++] = (tg_tape_record_t){
+        .op = op,
+        .inputs = { a, b },
+        .input_versions = { a ? tensor_version(a) : 0, b ? tensor_version(b) : 0 },
+        .output = output,
+    };
+    return SUCCESS;
+}
+
+// Records are appended in execution order, which is already a topological
+// order, so the backward pass is a single reverse sweep over the array.
+tg_err_t tensor_tape_backward(tg_tape_t* tape, tg_tensor_t* loss) {
+    assert(tape != NULL);
+    assert(loss != NULL);
+
+    TENSOR_GRADS_SET(loss, 1.0);
+    for (size_t i = tape->n_records; i-- > 0;) {
+        tg_tape_record_t* record = &tape->records[i];
+        if ((size_t)record->op >= TG_BOP_COUNT) { return ERR_INVALID_BACKWARDS_OP; }
+        tg_err_t (*kernel)(tg_tensor_t*, tg_tensor_t*, tg_tensor_t*) = tg_bop_grad_kernels[record->op];
+        if (!kernel) { return ERR_INVALID_BACKWARDS_OP; }
+
+        tg_err_t err = tensor_check_saved_versions(record->op, record->output, record->inputs,
+                                                   record->input_versions, 2);
+        if (err != SUCCESS) { return err; }
+        err = kernel(record->output, record->inputs[0], record->inputs[1]);
+        if (err != SUCCESS) { return err; }
+    }
+    return SUCCESS;
+}
+
+// Frees every recorded output and empties the tape, keeping its capacity so
+// the next step can record without allocating.
+void tensor_tape_reset(tg_tape_t* tape) {
+    assert(tape != NULL);
+
+    for (size_t i = 0; i < tape->n_records; i++) {
+        tensor_free(tape->records[i].output);
+    }
+    tape->n_records = 0;
+}
+
+void tensor_tape_free(tg_tape_t* tape) {
+    assert(tape != NULL);
+
+    tensor_tape_reset(tape);
+    free(tape->records);
+    *tape = (tg_tape_t){0};
+}
+
+// Forward elementwise kernel shared by the eager ops and fused expressions.
+static void tensor_el_forward_kernel(enum tg_backward_op op, const tg_value_t* x,
+                                     const tg_value_t* y, tg_value_t* out, size_t n) {
+    switch (op) {
+        case TG_BOP_EL_ADD:
+            tg_simd->add(x, y, out, n);
+            break;
+        case TG_BOP_EL_SUB:
+            tg_simd->sub(x, y, out, n);
+            break;
+        case TG_BOP_EL_MUL:
+            tg_simd->mul(x, y, out, n);
+            break;
+        case TG_BOP_EL_DIV:
+            tg_simd->div(x, y, out, n);
+            break;
+        default:
+            UNREACHABLE();
+    }
+}
+
+// Backward of one elementwise op over n elements: dx += d * ∂op/∂x and
+// dy += d * ∂op/∂y, skipping a NULL dx or dy.
+static void tensor_el_grad_kernel(enum tg_backward_op op, tg_value_t* dx, tg_value_t* dy, const tg_value_t* d,
+                                  const tg_value_t* x, const tg_value_t* y, size_t n) {
+    switch (op) {
+        case TG_BOP_EL_ADD:
+            if (dx) { tg_simd->grad_acc(dx, d, n); }
+            if (dy) { tg_simd->grad_acc(dy, d, n); }
+            break;
+        case TG_BOP_EL_SUB:
+            if (dx) { tg_simd->grad_acc(dx, d, n); }
+            if (dy) { tg_simd->grad_acc_neg(dy, d, n); }
+            break;
+        case TG_BOP_EL_MUL:
+            if (dx) { tg_simd->grad_mul(dx, d, y, n); }
+            if (dy) { tg_simd->grad_mul(dy, d, x, n); }
+            break;
+        case TG_BOP_EL_DIV:
+            if (dx) { tg_simd->grad_div_lhs(dx, d, y, n); }
+            if (dy) { tg_simd->grad_div_rhs(dy, d, x, y, n); }
+            break;
+        default:
+            UNREACHABLE();
+    }
+}
+
+// ==============================
+//        Strided iteration
+// ==============================
+// Shared engine for every op over tensors that may be strided, broadcast or
+// reduced: up to TG_ITER_OPERANDS operands walked over one index space.
+// tensor_iter_plan drops size-1 axes, orders the rest so operands are read
+// in memory order (outermost axis first) and merges axes that every operand
+// steps through contiguously, so most walks end in long runs that the leaf
+// hands to the SIMD kernels in one call. A size-1 or missing operand axis
+// has stride 0, which broadcasts (inputs) or reduces (operand 0).
+#define TG_ITER_OPERANDS 4
+// Innermost runs that are not contiguous are fed to the kernels through
+// splat or gather buffers of this many elements.
+#define TG_ITER_BLOCK 128
+// When an input is strided along the innermost run but contiguous along the
+// run outside it (e.g. a transposed operand), the last two runs are walked
+// in tiles of this many rows of the outer run by columns of the inner one,
+// and the input's tile is packed with contiguous reads, so the leaf sees
+// contiguous runs for it. Short, wide tiles keep the leaf's runs long and
+// the other operands' accesses close to sequential.
+#define TG_ITER_TILE_ROWS 16
+#define TG_ITER_TILE_COLS 256
+
+// Operand 0 is written: the output in forward, a gradient in backward.
+typedef struct tg_iter_t tg_iter_t;
+struct tg_iter_t {
+    size_t n_runs;
+    size_t* dims;
+    size_t (*strides)[TG_ITER_OPERANDS];
+    size_t inner[TG_ITER_OPERANDS];
+    tg_value_t* base[TG_ITER_OPERANDS];
+    void (*leaf)(const tg_iter_t* it, tg_value_t* const p[TG_ITER_OPERANDS], size_t n);
+    // Whether the last two runs are walked in tiles.
+    bool tile;
+    // Read-only operands packed per tile.
+    bool packed[TG_ITER_OPERANDS];
+    // Tasks cover `chunk` indices of run `split` each.
+    size_t split;
+    size_t chunk;
+
+    // Elementwise leaves: the op, and in backward whether operand 0 is the
+    // gradient of the rhs.
+    enum tg_backward_op op;
+    bool rhs;
+    // Map: the kernel applied in place, unary or with `scalar`.
+    void (*unary)(const tg_value_t* x, tg_value_t* out, size_t n);
+    void (*scalar_fn)(const tg_value_t* x, tg_value_t s, tg_value_t* out, size_t n);
+    tg_value_t scalar;
+};
+
+// Whether axis `a` should be walked outside axis `b`: some operand steps
+// further along a than along b, and none the other way round.
+static bool tensor_iter_outer(const size_t a[TG_ITER_OPERANDS], const size_t b[TG_ITER_OPERANDS]) {
+    bool outer = false;
+    for (size_t k = 0; k < TG_ITER_OPERANDS; k++) {
+        if (a[k] == 0 || b[k] == 0) { continue; }
+        if (a[k] < b[k]) { return false; }
+        outer = outer || a[k] > b[k];
+    }
+    return outer;
+}
+
+static void tensor_iter_plan(const size_t dims[], size_t n_dims, const tg_tensor_shape_t* const shapes[],
+                             tg_iter_t* it) {
+    // Axes are right-aligned against each operand's shape.
+    size_t n_axes = 0;
+    for (size_t i = 0; i < n_dims; i++) {
+        if (dims[i] == 1) { continue; }
+        for (size_t k = 0; k < TG_ITER_OPERANDS; k++) {
+            const tg_tensor_shape_t* s = shapes[k];
+            size_t offset = n_dims - s->n_dimensions;
+            it->strides[n_axes][k] = i < offset || s->dimensions[i - offset] == 1 ? 0 : s->strides[i - offset];
+        }
+        it->dims[n_axes++] = dims[i];
+    }
+
+    // Stable insertion sort into memory order; axes the operands disagree
+    // on keep their logical order, which favours the written operand.
+    for (size_t i = 1; i < n_axes; i++) {
+        for (size_t j = i; j > 0 && tensor_iter_outer(it->strides[j], it->strides[j - 1]); j--) {
+            size_t dim = it->dims[j];
+            it->dims[j] = it->dims[j - 1];
+            it->dims[j - 1] = dim;
+            size_t strides[TG_ITER_OPERANDS];
+            memcpy(strides, it->strides[j], sizeof(strides));
+            memcpy(it->strides[j], it->strides[j - 1], sizeof(strides));
+            memcpy(it->strides[j - 1], strides, sizeof(strides));
+        }
+    }
+
+    it->n_runs = 0;
+    for (size_t i = 0; i < n_axes; i++) {
+        bool merge = it->n_runs > 0;
+        for (size_t k = 0; k < TG_ITER_OPERANDS && merge; k++) {
+            merge = it->strides[it->n_runs - 1][k] == it->dims[i] * it->strides[i][k];
+        }
+        size_t run = merge ? it->n_runs - 1 : it->n_runs++;
+        it->dims[run] = merge ? it->dims[run] * it->dims[i] : it->dims[i];
+        memcpy(it->strides[run], it->strides[i], sizeof(it->strides[i]));
+    }
+
+    it->tile = false;
+    for (size_t k = 0; k < TG_ITER_OPERANDS; k++) {
+        it->inner[k] = it->n_runs ? it->strides[it->n_runs - 1][k] : 1;
+        it->packed[k] = k > 0 && it->n_runs >= 2 && it->inner[k] > 1 && it->strides[it->n_runs - 2][k] == 1;
+        it->tile = it->tile || it->packed[k];
+    }
+}
+
+// The last two runs, the outer one over `n` indices from q, in tiles.
+static void tensor_iter_tiles(const tg_iter_t* it, tg_value_t* const q[TG_ITER_OPERANDS], size_t n,
+                              size_t lo, size_t hi) {
+    size_t level = it->n_runs - 1;
+    size_t begin = level == it->split ? lo : 0;
+    size_t end = level == it->split ? hi : it->dims[level];
+
+    // Leaves read packed operands with stride 1.
+    tg_iter_t tiled = *it;
+    for (size_t k = 0; k < TG_ITER_OPERANDS; k++) {
+        if (it->packed[k]) { tiled.inner[k] = 1; }
+    }
+    // Operand 0 is never packed.
+    tg_value_t tiles[TG_ITER_OPERANDS - 1][TG_ITER_TILE_ROWS * TG_ITER_TILE_COLS];
+    tg_value_t* r[TG_ITER_OPERANDS];
+    for (size_t jj = 0; jj < n; jj += TG_ITER_TILE_ROWS) {
+        size_t rows = n - jj < TG_ITER_TILE_ROWS ? n - jj : TG_ITER_TILE_ROWS;
+        for (size_t ii = begin; ii < end; ii += TG_ITER_TILE_COLS) {
+            size_t len = end - ii < TG_ITER_TILE_COLS ? end - ii : TG_ITER_TILE_COLS;
+            for (size_t k = 1; k < TG_ITER_OPERANDS; k++) {
+                if (!it->packed[k] || !q[k]) { continue; }
+                // tiles[k - 1][j][i] = operand at (jj + j, ii + i), read along j.
+                for (size_t i = 0; i < len; i++) {
+                    const tg_value_t* src = q[k] + jj + (ii + i) * it->inner[k];
+                    for (size_t j = 0; j < rows; j++) { tiles[k - 1][j * TG_ITER_TILE_COLS + i] = src[j]; }
+                }
+            }
+            for (size_t j = 0; j < rows; j++) {
+                for (size_t k = 0; k < TG_ITER_OPERANDS; k++) {
+                    if (k > 0 && it->packed[k] && q[k]) {
+                        r[k] = tiles[k - 1] + j * TG_ITER_TILE_COLS;
+                    } else {
+                        r[k] = q[k] ? q[k] + (jj + j) * it->strides[level - 1][k] + ii * it->inner[k] : NULL;
+                    }
+                }
+                tiled.leaf(&tiled, r, len);
+            }
+        }
+    }
+}
+
+// Walks every run from `level` inwards, restricting run `split` to [lo, hi).
+static void tensor_iter_walk(const tg_iter_t* it, size_t level, tg_value_t* const p[TG_ITER_OPERANDS],
+                             size_t lo, size_t hi) {
+    size_t begin = level == it->split ? lo : 0;
+    size_t n = (level == it->split ? hi : it->dims[level]) - begin;
+
+    tg_value_t* q[TG_ITER_OPERANDS];
+    for (size_t k = 0; k < TG_ITER_OPERANDS; k++) {
+        q[k] = p[k] ? p[k] + begin * it->strides[level][k] : NULL;
+    }
+    if (level + 1 == it->n_runs) {
+        it->leaf(it, q, n);
+        return;
+    }
+    if (it->tile && level + 2 == it->n_runs) {
+        tensor_iter_tiles(it, q, n, lo, hi);
+        return;
+    }
+    for (size_t j = 0; j < n; j++) {
+        tensor_iter_walk(it, level + 1, q, lo, hi);
+        for (size_t k = 0; k < TG_ITER_OPERANDS; k++) {
+            if (q[k]) { q[k] += it->strides[level][k]; }
+        }
+    }
+}
+
+static void tensor_iter_task(void* ctx, size_t task, size_t worker) {
+    (void)worker;
+    const tg_iter_t* it = ctx;
+    size_t lo = task * it->chunk;
+    size_t hi = lo + it->chunk < it->dims[it->split] ? lo + it->chunk : it->dims[it->split];
+    tensor_iter_walk(it, 0, it->base, lo, hi);
+}
+
+// Tasks split the outermost run that operand 0 steps along, so each of its
+// elements is written by exactly one task in a fixed order. When operand 0
+// is a single element (a full reduction) the walk stays serial.
+static void tensor_iter_run(tg_iter_t* it, size_t n_elements) {
+    if (it->n_runs == 0) {
+        it->leaf(it, it->base, 1);
+        return;
+    }
+    it->split = 0;
+    while (it->split + 1 < it->n_runs && it->strides[it->split][0] == 0) { it->split++; }
+    size_t n_tasks = 1;
+    it->chunk = it->dims[it->split];
+    if (it->strides[it->split][0] != 0) {
+        n_tasks = tensor_unit_dim_tasks(it->dims[it->split], n_elements, 1, &it->chunk);
+    }
+    tensor_parallel_for(n_tasks, tensor_get_num_threads(), tensor_iter_task, it);
+}
+
+// Returns the n <= TG_ITER_BLOCK values of the run at x with the given
+// stride as a contiguous array: x itself for stride 1, otherwise a splat
+// (stride 0) or gathered copy in buf.
+static tg_value_t* tensor_run_load(tg_value_t* x, size_t stride, tg_value_t* buf, size_t n) {
+    if (stride == 1 || !x) { return x; }
+    for (size_t i = 0; i < n; i++) { buf[i] = x[i * stride]; }
+    return buf;
+}
+
+// Writes back a run returned by tensor_run_load with stride > 1.
+static void tensor_run_store(tg_value_t* x, size_t stride, const tg_value_t* buf, size_t n) {
+    if (stride == 1) { return; }
+    for (size_t i = 0; i < n; i++) { x[i * stride] = buf[i]; }
+}
+
+#define TG_RUN_AT(it, p, k, i) ((p)[k] ? (p)[k] + (i) * (it)->inner[k] : NULL)
+
+// p = {dst, src}: copies a run between any two layouts.
+static void tensor_iter_copy_leaf(const tg_iter_t* it, tg_value_t* const p[TG_ITER_OPERANDS], size_t n) {
+    tg_value_t buf[TG_ITER_BLOCK];
+    for (size_t i = 0; i < n; i += TG_ITER_BLOCK) {
+        size_t len = n - i < TG_ITER_BLOCK ? n - i : TG_ITER_BLOCK;
+        tg_value_t* dst = TG_RUN_AT(it, p, 0, i);
+        const tg_value_t* src = tensor_run_load(TG_RUN_AT(it, p, 1, i), it->inner[1], buf, len);
+        if (it->inner[0] == 1) {
+            memcpy(dst, src, len * sizeof(tg_value_t));
+        } else {
+            tensor_run_store(dst, it->inner[0], src, len);
+        }
+    }
+}
+
+// p = {x}: applies a unary or scalar kernel to a run in place.
+static void tensor_iter_map_leaf(const tg_iter_t* it, tg_value_t* const p[TG_ITER_OPERANDS], size_t n) {
+    tg_value_t buf[TG_ITER_BLOCK];
+    for (size_t i = 0; i < n; i += TG_ITER_BLOCK) {
+        size_t len = n - i < TG_ITER_BLOCK ? n - i : TG_ITER_BLOCK;
+        tg_value_t* x = TG_RUN_AT(it, p, 0, i);
+        tg_value_t* run = tensor_run_load(x, it->inner[0], buf, len);
+        if (it->unary) {
+            it->unary(run, run, len);
+        } else {
+            it->scalar_fn(run, it->scalar, run, len);
+        }
+        tensor_run_store(x, it->inner[0], run, len);
+    }
+}
+
+// p = {y, x}: y += scalar * x. A stride-0 y sums the run (a reduction), a
+// stride-0 x is added to every element (its broadcast).
+static void tensor_iter_axpy_leaf(const tg_iter_t* it, tg_value_t* const p[TG_ITER_OPERANDS], size_t n) {
+    if (it->inner[0] == 0) {
+        double sum = 0.0;
+        if (it->inner[1] == 0) {
+            sum = (double)p[1][0] * (double)n;
+        } else if (it->inner[1] == 1) {
+            sum = tensor_sum_pairwise(p[1], n);
+        } else {
+            tg_value_t buf[TG_ITER_BLOCK];
+            for (size_t i = 0; i < n; i += TG_ITER_BLOCK) {
+                size_t len = n - i < TG_ITER_BLOCK ? n - i : TG_ITER_BLOCK;
+                sum += tg_simd->sum(tensor_run_load(TG_RUN_AT(it, p, 1, i), it->inner[1], buf, len), len);
+            }
+        }
+        p[0][0] += it->scalar * (tg_value_t)sum;
+        return;
+    }
+
+    tg_value_t buf_y[TG_ITER_BLOCK], buf_x[TG_ITER_BLOCK];
+    for (size_t i = 0; i < n; i += TG_ITER_BLOCK) {
+        size_t len = n - i < TG_ITER_BLOCK ? n - i : TG_ITER_BLOCK;
+        tg_value_t* y = TG_RUN_AT(it, p, 0, i);
+        tg_value_t* run = tensor_run_load(y, it->inner[0], buf_y, len);
+        if (it->inner[1] == 0) {
+            tg_simd->scalar_add(run, it->scalar * p[1][0], run, len);
+        } else {
+            tg_simd->axpy(run, it->scalar, tensor_run_load(TG_RUN_AT(it, p, 1, i), it->inner[1], buf_x, len), len);
+        }
+        tensor_run_store(y, it->inner[0], run, len);
+    }
+}
+
+// ==============================
+//         Broadcasting
+// ==============================
+// Operands are aligned on their last axis and a size-1 (or missing) axis
+// is read with stride 0, so a broadcast operand is never copied out to
+// the full shape.
+static bool tensor_same_shape(const tg_tensor_t* a, const tg_tensor_t* b) {
+    return a->shape.n_dimensions == b->shape.n_dimensions
+        && memcmp(a->shape.dimensions, b->shape.dimensions, a->shape.n_dimensions * sizeof(size_t)) == 0;
+}
+
+static size_t tensor_broadcast_rank(const tg_tensor_t* a, const tg_tensor_t* b) {
+    return a->shape.n_dimensions > b->shape.n_dimensions ? a->shape.n_dimensions : b->shape.n_dimensions;
+}
+
+static void tensor_broadcast_dims(const tg_tensor_t* a, const tg_tensor_t* b, size_t dims[], size_t n_dims) {
+    for (size_t i = 0; i < n_dims; i++) {
+        size_t da = i < a->shape.n_dimensions ? a->shape.dimensions[a->shape.n_dimensions - 1 - i] : 1;
+        size_t db = i < b->shape.n_dimensions ? b->shape.dimensions[b->shape.n_dimensions - 1 - i] : 1;
+        assert((da == db || da == 1 || db == 1) && "shapes cannot be broadcast together");
+        dims[n_dims - 1 - i] = da > db ? da : db;
+    }
+}
+
+// p = {out, A, B}.
+static void tensor_bcast_forward_leaf(const tg_iter_t* it, tg_value_t* const p[TG_ITER_OPERANDS], size_t n) {
+    tg_value_t buf_out[TG_ITER_BLOCK], buf_x[TG_ITER_BLOCK], buf_y[TG_ITER_BLOCK];
+    for (size_t i = 0; i < n; i += TG_ITER_BLOCK) {
+        size_t len = n - i < TG_ITER_BLOCK ? n - i : TG_ITER_BLOCK;
+        tg_value_t* out = TG_RUN_AT(it, p, 0, i);
+        const tg_value_t* x = tensor_run_load(TG_RUN_AT(it, p, 1, i), it->inner[1], buf_x, len);
+        const tg_value_t* y = tensor_run_load(TG_RUN_AT(it, p, 2, i), it->inner[2], buf_y, len);
+        tg_value_t* dst = it->inner[0] == 1 ? out : buf_out;
+        tensor_el_forward_kernel(it->op, x, y, dst, len);
+        tensor_run_store(out, it->inner[0], dst, len);
+    }
+}
+
+// p = {gradient being accumulated, dC, A, B}. A stride-0 gradient is summed
+// over the run from a scratch block.
+static void tensor_bcast_backward_leaf(const tg_iter_t* it, tg_value_t* const p[TG_ITER_OPERANDS], size_t n) {
+    tg_value_t buf_dst[TG_ITER_BLOCK], buf_d[TG_ITER_BLOCK], buf_x[TG_ITER_BLOCK], buf_y[TG_ITER_BLOCK];
+    for (size_t i = 0; i < n; i += TG_ITER_BLOCK) {
+        size_t len = n - i < TG_ITER_BLOCK ? n - i : TG_ITER_BLOCK;
+        tg_value_t* grad = TG_RUN_AT(it, p, 0, i);
+        const tg_value_t* d = tensor_run_load(TG_RUN_AT(it, p, 1, i), it->inner[1], buf_d, len);
+        const tg_value_t* x = tensor_run_load(TG_RUN_AT(it, p, 2, i), it->inner[2], buf_x, len);
+        const tg_value_t* y = tensor_run_load(TG_RUN_AT(it, p, 3, i), it->inner[3], buf_y, len);
+        tg_value_t* dst = buf_dst;
+        if (it->inner[0] == 0) {
+            memset(buf_dst, 0, len * sizeof(tg_value_t));
+        } else {
+            dst = tensor_run_load(grad, it->inner[0], buf_dst, len);
+        }
+        tensor_el_grad_kernel(it->op, it->rhs ? NULL : dst, it->rhs ? dst : NULL, d, x, y, len);
+        if (it->inner[0] == 0) {
+            grad[0] += tg_simd->sum(buf_dst, len);
+        } else {
+            tensor_run_store(grad, it->inner[0], dst, len);
+        }
+    }
+}
+
+// out = a op b with out shaped like the broadcast of a and b.
+static void tensor_el_broadcast_forward(enum tg_backward_op op, tg_tensor_t* a, tg_tensor_t* b, tg_tensor_t* out) {
+    size_t n_dims = out->shape.n_dimensions;
+    size_t run_dims[n_dims];
+    size_t strides[n_dims][TG_ITER_OPERANDS];
+    const tg_tensor_shape_t* shapes[TG_ITER_OPERANDS] = { &out->shape, &a->shape, &b->shape, &out->shape };
+    tg_iter_t it = {
+        .dims = run_dims, .strides = strides, .leaf = tensor_bcast_forward_leaf, .op = op,
+        .base = { out->vals, a->vals, b->vals, NULL },
+    };
+    tensor_iter_plan(out->shape.dimensions, n_dims, shapes, &it);
+    tensor_iter_run(&it, out->n_elements);
+}
+
+// dA and dB from dC for a broadcast op, each reduced back to its operand's
+// shape during the same walk that computes it.
+static tg_err_t tensor_grad_el_broadcast(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B,
+                                         tg_value_t* dA, tg_value_t* dB, enum tg_backward_op op) {
+    size_t n_dims = C->shape.n_dimensions;
+    size_t run_dims[n_dims];
+    size_t strides[n_dims][TG_ITER_OPERANDS];
+    for (size_t side = 0; side < 2; side++) {
+        tg_value_t* dX = side ? dB : dA;
+        if (!dX) { continue; }
+        // Gradients are contiguous even when the operand is a view.
+        tg_tensor_t* X = side ? B : A;
+        size_t storage[2 * X->shape.n_dimensions];
+        tg_tensor_shape_t dense;
+        tensor_dense_shape(X, storage, &dense);
+        const tg_tensor_shape_t* shapes[TG_ITER_OPERANDS] = { &dense, &C->shape, &A->shape, &B->shape };
+        tg_iter_t it = {
+            .dims = run_dims, .strides = strides, .leaf = tensor_bcast_backward_leaf, .op = op, .rhs = side,
+            .base = { dX, C->grads, A->vals, B->vals },
+        };
+        tensor_iter_plan(C->shape.dimensions, n_dims, shapes, &it);
+        tensor_iter_run(&it, C->n_elements);
+    }
+    return SUCCESS;
+}
+
+// ==============================
+//             Views
+// ==============================
+// A view is a header with its own dimensions and strides over another
+// tensor's storage, so reshape, permute and slice never copy. Writes
+// through a view land in the base tensor, and its gradient is scattered
+// back into the base's grads by a TG_BOP_VIEW node. A view keeps the
+// storage alive, so it stays valid after the base tensor is freed.
+bool tensor_is_contiguous(const tg_tensor_t* x) {
+    size_t expected = 1;
+    for (size_t i = x->shape.n_dimensions; i-- > 0;) {
+        if (x->shape.dimensions[i] != 1 && x->shape.strides[i] != expected) { return false; }
+        expected *= x->shape.dimensions[i];
+    }
+    return true;
+}
+
+// Same shape and both contiguous: elementwise ops run as one flat loop.
+static bool tensor_flat_pair(const tg_tensor_t* a, const tg_tensor_t* b) {
+    return tensor_same_shape(a, b) && tensor_is_contiguous(a) && tensor_is_contiguous(b);
+}
+
+// x's dimensions with contiguous strides, the layout of x's grads.
+// `storage` holds 2 * x's rank entries.
+static void tensor_dense_shape(const tg_tensor_t* x, size_t* storage, tg_tensor_shape_t* shape) {
+    tensor_shape_init_with(x->shape.dimensions, x->shape.n_dimensions, storage, shape);
+}
+
+// dst = src between two layouts of the same dimensions.
+static void tensor_strided_copy(tg_value_t* dst, const tg_tensor_shape_t* dst_shape,
+                                tg_value_t* src, const tg_tensor_shape_t* src_shape, size_t n_elements) {
+    size_t n_dims = dst_shape->n_dimensions;
+    size_t run_dims[n_dims];
+    size_t strides[n_dims][TG_ITER_OPERANDS];
+    const tg_tensor_shape_t* shapes[TG_ITER_OPERANDS] = { dst_shape, src_shape, dst_shape, dst_shape };
+    tg_iter_t it = {
+        .dims = run_dims, .strides = strides, .leaf = tensor_iter_copy_leaf,
+        .base = { dst, src, NULL, NULL },
+    };
+    tensor_iter_plan(dst_shape->dimensions, n_dims, shapes, &it);
+    tensor_iter_run(&it, n_elements);
+}
 
+// x's values in row-major order for kernels that need a flat buffer:
+// x->vals itself when x is contiguous, otherwise a gathered copy in
+// *scratch, which the caller frees.
+static tg_err_t tensor_dense_vals(tg_tensor_t* x, const tg_value_t** vals, tg_value_t** scratch) {
+    *scratch = NULL;
+    *vals = x->vals;
+    if (tensor_is_contiguous(x)) { return SUCCESS; }
+
+    *scratch = tensor_aligned_alloc(x->n_elements * sizeof(tg_value_t));
+    if (!*scratch) { return ERR_MEMORY_ALLOCATION; }
+    size_t storage[2 * x->shape.n_dimensions];
+    tg_tensor_shape_t dense;
+    tensor_dense_shape(x, storage, &dense);
+    tensor_strided_copy(*scratch, &dense, x->vals, &x->shape, x->n_elements);
+    *vals = *scratch;
+    return SUCCESS;
+}
+
+// Storage index of x's i-th element in row-major order.
+static size_t tensor_element_offset(const tg_tensor_t* x, size_t i) {
+    size_t offset = x->storage_offset;
+    for (size_t d = x->shape.n_dimensions; d-- > 0;) {
+        offset += i % x->shape.dimensions[d] * x->shape.strides[d];
+        i /= x->shape.dimensions[d];
+    }
+    return offset;
+}
+
+// Whether a <- a op b would read elements of b that the op has already
+// overwritten through a: the two share storage, some element is in both,
+// and they are not the same view (a op= a is fine). Elements of the common
+// address range are marked in a bitmap, so interleaved views that never
+// touch the same element pass. Only evaluated by asserts.
+static inline bool tensor_inplace_overlaps(const tg_tensor_t* a, const tg_tensor_t* b) {
+    if (a->storage != b->storage || a->n_elements == 0 || b->n_elements == 0) { return false; }
+    if (a->storage_offset == b->storage_offset && tensor_same_shape(a, b)
+        && memcmp(a->shape.strides, b->shape.strides, a->shape.n_dimensions * sizeof(size_t)) == 0) {
+        return false;
+    }
+
+    // Strides are non-negative, so the first and last elements bound each range.
+    size_t a_last = tensor_element_offset(a, a->n_elements - 1);
+    size_t b_last = tensor_element_offset(b, b->n_elements - 1);
+    size_t lo = a->storage_offset > b->storage_offset ? a->storage_offset : b->storage_offset;
+    size_t hi = a_last < b_last ? a_last : b_last;
+    if (lo > hi) { return false; }
+
+    unsigned char* marks = calloc((hi - lo) / 8 + 1, 1);
+    if (!marks) { return true; }
+    for (size_t i = 0; i < a->n_elements; i++) {
+        size_t offset = tensor_element_offset(a, i);
+        if (offset >= lo && offset <= hi) { marks[(offset - lo) / 8] |= 1u << ((offset - lo) % 8); }
+    }
+    bool overlaps = false;
+    for (size_t i = 0; i < b->n_elements && !overlaps; i++) {
+        size_t offset = tensor_element_offset(b, i);
+        overlaps = offset >= lo && offset <= hi && (marks[(offset - lo) / 8] >> ((offset - lo) % 8) & 1u);
+    }
+    free(marks);
+    return overlaps;
+}
+
+// In-place kernels on a view that is not contiguous.
+static void tensor_map_strided(tg_tensor_t* x, void (*unary)(const tg_value_t*, tg_value_t*, size_t),
+                               void (*scalar_fn)(const tg_value_t*, tg_value_t, tg_value_t*, size_t),
+                               tg_value_t scalar) {
+    size_t n_dims = x->shape.n_dimensions;
+    size_t run_dims[n_dims];
+    size_t strides[n_dims][TG_ITER_OPERANDS];
+    const tg_tensor_shape_t* shapes[TG_ITER_OPERANDS] = { &x->shape, &x->shape, &x->shape, &x->shape };
+    tg_iter_t it = {
+        .dims = run_dims, .strides = strides, .leaf = tensor_iter_map_leaf,
+        .base = { x->vals, NULL, NULL, NULL },
+        .unary = unary, .scalar_fn = scalar_fn, .scalar = scalar,
+    };
+    tensor_iter_plan(x->shape.dimensions, n_dims, shapes, &it);
+    tensor_iter_run(&it, x->n_elements);
+}
+
+// The version lives in the storage, so an in-place write through a view
+// also invalidates saved copies of its base and other views, and back.
+static void tensor_bump_version(tg_tensor_t* x) {
+    x->storage->version += 1;
+}
+
+static tg_tensor_t* tensor_view(tg_tensor_t* x, size_t dims[], const size_t strides[], size_t n_dims,
+                                size_t offset) {
+    UNWRAP(tensor_realize(x));
+    tg_tensor_t* base = x->view_base ? x->view_base : x;
+
+    tg_tensor_t* view = NULL;
+    UNWRAP(tensor_init_block(dims, n_dims, false, true, &view));
+    memcpy(view->shape.strides, strides, n_dims * sizeof(size_t));
+    tensor_attach_storage(view, x->storage, x->storage_offset + offset);
+    view->view_base = base;
+
+    tensor_create_graph(view, base, NULL, TG_BOP_VIEW);
+    return view;
+}
+
+// Same values with new dimensions; x must be contiguous (see
+// tensor_contiguous).
+tg_tensor_t* tensor_reshape(tg_tensor_t* x, size_t dims[], size_t n_dims) {
+    assert(x != NULL);
+    assert(total_elements_for_dimensions(dims, n_dims) == x->n_elements);
+    assert(tensor_is_contiguous(x) && "reshape needs a contiguous tensor");
+
+    size_t strides[n_dims];
+    size_t stride = 1;
+    for (size_t i = n_dims; i-- > 0;) {
+        strides[i] = stride;
+        stride *= dims[i];
+    }
+    return tensor_view(x, dims, strides, n_dims, 0);
+}
+
+// Axis i of the result is axis perm[i] of x.
+tg_tensor_t* tensor_permute(tg_tensor_t* x, const size_t perm[]) {
+    assert(x != NULL);
+    size_t n_dims = x->shape.n_dimensions;
+    size_t dims[n_dims];
+    size_t strides[n_dims];
+    bool seen[n_dims];
+    memset(seen, 0, sizeof(seen));
+    for (size_t i = 0; i < n_dims; i++) {
+        assert(perm[i] < n_dims && !seen[perm[i]] && "perm must be a permutation of the axes");
+        seen[perm[i]] = true;
+        dims[i] = x->shape.dimensions[perm[i]];
+        strides[i] = x->shape.strides[perm[i]];
+    }
+    return tensor_view(x, dims, strides, n_dims, 0);
+}
+
+tg_tensor_t* tensor_transpose(tg_tensor_t* x, size_t dim0, size_t dim1) {
+    assert(x != NULL);
+    size_t n_dims = x->shape.n_dimensions;
+    assert(dim0 < n_dims && dim1 < n_dims);
+    size_t perm[n_dims];
+    for (size_t i = 0; i < n_dims; i++) { perm[i] = i; }
+    perm[dim0] = dim1;
+    perm[dim1] = dim0;
+    return tensor_permute(x, perm);
+}
+
+// Elements [start, end) along `axis`.
+tg_tensor_t* tensor_slice(tg_tensor_t* x, size_t axis, size_t start, size_t end) {
+    assert(x != NULL);
+    size_t n_dims = x->shape.n_dimensions;
+    assert(axis < n_dims);
+    assert(start < end && end <= x->shape.dimensions[axis]);
+
+    size_t dims[n_dims];
+    memcpy(dims, x->shape.dimensions, sizeof(dims));
+    dims[axis] = end - start;
+    return tensor_view(x, dims, x->shape.strides, n_dims, start * x->shape.strides[axis]);
+}
+
+// A contiguous copy of x, e.g. to reshape a permuted view.
+tg_tensor_t* tensor_contiguous(tg_tensor_t* x) {
+    assert(x != NULL);
+    UNWRAP(tensor_realize(x));
+
+    tg_tensor_t* tensor = NULL;
+    UNWRAP(tensor_init_uninit(x->shape.dimensions, x->shape.n_dimensions, &tensor));
+    tensor_strided_copy(tensor->vals, &tensor->shape, x->vals, &x->shape, x->n_elements);
+
+    tensor_create_graph(tensor, x, NULL, TG_BOP_COPY);
+    return tensor;
+}
+
+// dA[offset + strided index] += dC, with A the view's base.
+static tg_err_t tensor_grad_view(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    (void)B;
+    TG_UNARY_GRAD_KERNEL_PROLOGUE(C, A, dA);
+
+    size_t n_dims = C->shape.n_dimensions;
+    size_t run_dims[n_dims];
+    size_t strides[n_dims][TG_ITER_OPERANDS];
+    size_t storage[2 * n_dims];
+    tg_tensor_shape_t dense;
+    tensor_dense_shape(C, storage, &dense);
+    const tg_tensor_shape_t* shapes[TG_ITER_OPERANDS] = { &C->shape, &dense, &dense, &dense };
+    tg_iter_t it = {
+        .dims = run_dims, .strides = strides, .leaf = tensor_iter_axpy_leaf, .scalar = 1.0f,
+        .base = { dA + (C->storage_offset - A->storage_offset), C->grads, NULL, NULL },
+    };
+    tensor_iter_plan(C->shape.dimensions, n_dims, shapes, &it);
+    tensor_iter_run(&it, C->n_elements);
+    return SUCCESS;
+}
+
+static tg_err_t tensor_grad_copy(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    (void)B;
+    TG_UNARY_GRAD_KERNEL_PROLOGUE(C, A, dA);
+    tg_simd->grad_acc(dA, C->grads, C->n_elements);
+    return SUCCESS;
+}
+
+static tg_tensor_t* tensor_lazy_binary(tg_tensor_t* a, tg_tensor_t* b, enum tg_backward_op op);
+
+// Operands of different shapes are broadcast, and views are read through
+// their strides by the same walk. Only flat pairs are fused in lazy mode;
+// the others realize their operands and run eagerly.
+static tg_tensor_t* tensor_el_binary(tg_tensor_t* a, tg_tensor_t* b, enum tg_backward_op op) {
+    assert(a != NULL);
+    assert(b != NULL);
+
+    bool flat = tensor_flat_pair(a, b);
+    if (flat && tensor_lazy_enabled()) {
+        return tensor_lazy_binary(a, b, op);
+    }
+    UNWRAP(tensor_realize(a));
+    UNWRAP(tensor_realize(b));
+
+    if (!flat) {
+        size_t n_dims = tensor_broadcast_rank(a, b);
+        size_t dims[n_dims];
+        tensor_broadcast_dims(a, b, dims, n_dims);
+        tg_tensor_t* tensor = NULL;
+        UNWRAP(tensor_init_uninit(dims, n_dims, &tensor));
+        tensor_el_broadcast_forward(op, a, b, tensor);
+        tensor_create_graph(tensor, a, b, op);
+        return tensor;
+    }
+
+    tg_tensor_t* tensor = NULL;
+    UNWRAP(tensor_init_uninit(a->shape.dimensions, a->shape.n_dimensions, &tensor));
+
+    tensor_el_forward_kernel(op, a->vals, b->vals, tensor->vals, tensor->n_elements);
+
+    tensor_create_graph(tensor, a, b, op);
+    return tensor;
+}
+
+tg_tensor_t* tensor_el_add(tg_tensor_t* a, tg_tensor_t* b) {
+    return tensor_el_binary(a, b, TG_BOP_EL_ADD);
+}
+
+tg_tensor_t* tensor_el_sub(tg_tensor_t* a, tg_tensor_t* b) {
+    return tensor_el_binary(a, b, TG_BOP_EL_SUB);
+}
+
+tg_tensor_t* tensor_el_mul(tg_tensor_t* a, tg_tensor_t* b) {
+    return tensor_el_binary(a, b, TG_BOP_EL_MUL);
+}
+
+tg_tensor_t* tensor_el_div(tg_tensor_t* a, tg_tensor_t* b) {
+    return tensor_el_binary(a, b, TG_BOP_EL_DIV);
+}
+
+// ==============================
+//         Activations
+// ==============================
+// Out-of-place activations backed by the SIMD kernel table. exp, log, tanh
+// and sigmoid are polynomial approximations (Cephes single precision). The
+// measured error against libm is within 1.25 ulp for exp, log and tanh and
+// 2.5 ulp for sigmoid, on every ISA. exp flushes results below FLT_MIN to 0.
+// NaN propagates through every activation, and log's special cases (zero,
+// negative, infinite and subnormal inputs) match libm.
+static tg_tensor_t* tensor_activation(tg_tensor_t* x, enum tg_backward_op op,
+                                      void (*kernel)(const tg_value_t*, tg_value_t*, size_t)) {
+    assert(x != NULL);
+    UNWRAP(tensor_realize(x));
+
+    tg_tensor_t* tensor = NULL;
+    UNWRAP(tensor_init_uninit(x->shape.dimensions, x->shape.n_dimensions, &tensor));
+
+    if (tensor_is_contiguous(x)) {
+        kernel(x->vals, tensor->vals, tensor->n_elements);
+    } else {
+        tensor_strided_copy(tensor->vals, &tensor->shape, x->vals, &x->shape, x->n_elements);
+        kernel(tensor->vals, tensor->vals, tensor->n_elements);
+    }
+
+    tensor_create_graph(tensor, x, NULL, op);
+    return tensor;
+}
+
+tg_tensor_t* tensor_relu(tg_tensor_t* x) {
+    return tensor_activation(x, TG_BOP_RELU, tg_simd->relu);
+}
+
+tg_tensor_t* tensor_sigmoid(tg_tensor_t* x) {
+    return tensor_activation(x, TG_BOP_SIGMOID, tg_simd->sigmoid);
+}
+
+tg_tensor_t* tensor_tanh(tg_tensor_t* x) {
+    return tensor_activation(x, TG_BOP_TANH, tg_simd->tanh);
+}
+
+tg_tensor_t* tensor_exp(tg_tensor_t* x) {
+    return tensor_activation(x, TG_BOP_EXP, tg_simd->exp);
+}
+
+tg_tensor_t* tensor_log(tg_tensor_t* x) {
+    return tensor_activation(x, TG_BOP_LOG, tg_simd->log);
+}
+
+// ==============================
+//         Reductions
+// ==============================
+// Full reductions are split into tasks of this many elements, independent
+// of the thread count, so the result does not depend on it.
+#ifndef TG_REDUCE_TASK_ELEMENTS
+#define TG_REDUCE_TASK_ELEMENTS (64 * TG_DOT_BLOCK)
+#endif
+
+typedef struct {
+    const tg_value_t* x;
+    size_t n;
+    double* partials;
+} tg_sum_all_t;
+
+static void tensor_sum_all_task(void* ctx, size_t task, size_t worker) {
+    (void)worker;
+    tg_sum_all_t* s = ctx;
+    size_t lo = task * TG_REDUCE_TASK_ELEMENTS;
+    size_t n = s->n - lo < TG_REDUCE_TASK_ELEMENTS ? s->n - lo : TG_REDUCE_TASK_ELEMENTS;
+    s->partials[task] = tensor_sum_pairwise(s->x + lo, n);
+}
+
+// Sum of n contiguous values, one fixed-size task per partial.
+static tg_err_t tensor_sum_all(const tg_value_t* x, size_t n, double* sum) {
+    size_t n_tasks = (n + TG_REDUCE_TASK_ELEMENTS - 1) / TG_REDUCE_TASK_ELEMENTS;
+    if (n_tasks <= 1) {
+        *sum = tensor_sum_pairwise(x, n);
+        return SUCCESS;
+    }
+    tg_sum_all_t s = { .x = x, .n = n, .partials = malloc(n_tasks * sizeof(double)) };
+    if (!s.partials) { return ERR_MEMORY_ALLOCATION; }
+    tensor_parallel_for(n_tasks, tensor_get_num_threads(), tensor_sum_all_task, &s);
+    *sum = 0.0;
+    for (size_t t = 0; t < n_tasks; t++) { *sum += s.partials[t]; }
+    free(s.partials);
+    return SUCCESS;
+}
+
+// y += scale * x over the index space `dims`: axes where y has size 1 are
+// summed (a reduction), axes where x has size 1 are broadcast (its
+// gradient). Both may be strided.
+static void tensor_axpy_strided(tg_value_t* y, const tg_tensor_shape_t* ys, tg_value_t* x,
+                                const tg_tensor_shape_t* xs, const tg_tensor_shape_t* space,
+                                tg_value_t scale, size_t n_elements) {
+    size_t n_dims = space->n_dimensions;
+    size_t run_dims[n_dims];
+    size_t strides[n_dims][TG_ITER_OPERANDS];
+    const tg_tensor_shape_t* shapes[TG_ITER_OPERANDS] = { ys, xs, ys, ys };
+    tg_iter_t it = {
+        .dims = run_dims, .strides = strides, .leaf = tensor_iter_axpy_leaf, .scalar = scale,
+        .base = { y, x, NULL, NULL },
+    };
+    tensor_iter_plan(space->dimensions, n_dims, shapes, &it);
+    tensor_iter_run(&it, n_elements);
+}
+
+static tg_tensor_t* tensor_reduce(tg_tensor_t* x, const size_t axes[], size_t n_axes, bool mean) {
+    assert(x != NULL);
+    assert(axes != NULL || n_axes == 0);
+    UNWRAP(tensor_realize(x));
+
+    size_t n_dims = x->shape.n_dimensions;
+    size_t dims[n_dims];
+    if (n_axes == 0) {
+        for (size_t i = 0; i < n_dims; i++) { dims[i] = 1; }
+    } else {
+        memcpy(dims, x->shape.dimensions, n_dims * sizeof(size_t));
+        for (size_t i = 0; i < n_axes; i++) {
+            assert(axes[i] < n_dims && "reduction axis out of range");
+            dims[axes[i]] = 1;
+        }
+    }
+
+    tg_tensor_t* tensor = NULL;
+    UNWRAP(tensor_init(dims, n_dims, &tensor));
+
+    // A full reduction of a contiguous tensor is split into fixed pieces so
+    // it runs in parallel; everything else walks x in memory order, with
+    // tasks over the output.
+    if (tensor->n_elements == 1 && tensor_is_contiguous(x)) {
+        double sum = 0.0;
+        UNWRAP(tensor_sum_all(x->vals, x->n_elements, &sum));
+        tensor->vals[0] = (tg_value_t)sum;
+    } else {
+        tensor_axpy_strided(tensor->vals, &tensor->shape, x->vals, &x->shape, &x->shape, 1.0f, x->n_elements);
+    }
+    if (mean) {
+        tg_simd->scalar_mul(tensor->vals, (tg_value_t)tensor->n_elements / (tg_value_t)x->n_elements,
+                            tensor->vals, tensor->n_elements);
+    }
+
+    tensor_create_graph(tensor, x, NULL, mean ? TG_BOP_MEAN_REDUCTION : TG_BOP_SUM_REDUCTION);
+    return tensor;
+}
+
+// Sums over `axes`, or over every axis when n_axes is 0. Reduced axes are
+// kept with size 1, so the result broadcasts against x.
+tg_tensor_t* tensor_sum(tg_tensor_t* x, const size_t axes[], size_t n_axes) {
+    return tensor_reduce(x, axes, n_axes, false);
+}
+
+tg_tensor_t* tensor_mean(tg_tensor_t* x, const size_t axes[], size_t n_axes) {
+    return tensor_reduce(x, axes, n_axes, true);
+}
+
+// dA += scale * dC, with dC read through stride 0 along the reduced axes so
+// the broadcast is never materialized.
+static tg_err_t tensor_grad_reduce(tg_tensor_t* C, tg_tensor_t* A, tg_value_t scale) {
+    TG_UNARY_GRAD_KERNEL_PROLOGUE(C, A, dA);
+
+    size_t storage[2 * A->shape.n_dimensions];
+    tg_tensor_shape_t a_shape;
+    tensor_dense_shape(A, storage, &a_shape);
+    tensor_axpy_strided(dA, &a_shape, C->grads, &C->shape, &a_shape, scale, A->n_elements);
+    return SUCCESS;
+}
+
+static tg_err_t tensor_grad_sum(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    (void)B;
+    return tensor_grad_reduce(C, A, 1.0f);
+}
+
+static tg_err_t tensor_grad_mean(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    (void)B;
+    return tensor_grad_reduce(C, A, (tg_value_t)C->n_elements / (tg_value_t)A->n_elements);
+}
+
+tg_err_t tensor_backward_reduction(tg_tensor_t* tensor) {
     if(tensor->n_input_tensors == 0) {
         return SUCCESS;
     }
 
-    assert(tensor->n_input_tensors == 2);
+    assert(tensor->n_input_tensors == 1);
     assert(tensor->input_tensors[0] != NULL);
-    assert(tensor->input_tensors[1] != NULL);
-    assert(tensor->input_tensors[0]->shape.n_dimensions \
-           == tensor->input_tensors[1]->shape.n_dimensions);
 
-    tg_tensor_t* A = tensor->input_tensors[0];
-    tg_tensor_t* B = tensor->input_tensors[1];
+    if (tensor->op == TG_BOP_MEAN_REDUCTION) {
+        return tensor_grad_mean(tensor, tensor->input_tensors[0], NULL);
+    }
+    return tensor_grad_sum(tensor, tensor->input_tensors[0], NULL);
+}
+
+// ==============================
+//         Loss functions
+// ==============================
+// Softmax cross-entropy runs over row tasks of a fixed size, so the loss is
+// summed in the same order for any number of threads.
+#ifndef TG_XENT_TASK_ELEMENTS
+#define TG_XENT_TASK_ELEMENTS 32768
+#endif
+
+typedef struct {
+    const tg_value_t* logits;
+    const tg_value_t* targets;
+    size_t n_classes;
+    size_t n_rows;
+    size_t rows_per_task;
+    double* partials;
+    tg_value_t* dlogits;
+    tg_value_t scale;
+} tg_xent_t;
 
-    for (size_t i = 0; i < tensor->n_elements; i++) {
-        A->grads[i] += tensor->grads[i] * B->vals[i];
-        B->grads[i] += tensor->grads[i] * A->vals[i];
+// Targets are checked by tensor_xent_plan before any task reads them.
+static size_t tensor_xent_target(const tg_xent_t* x, size_t row) {
+    return (size_t)x->targets[row];
+}
+
+static void tensor_xent_forward_task(void* ctx, size_t task, size_t worker) {
+    (void)worker;
+    tg_xent_t* x = ctx;
+    size_t end = (task + 1) * x->rows_per_task;
+    double sum = 0.0;
+    for (size_t r = task * x->rows_per_task; r < end && r < x->n_rows; r++) {
+        const tg_value_t* row = x->logits + r * x->n_classes;
+        sum += (double)tg_simd->logsumexp(row, x->n_classes) - (double)row[tensor_xent_target(x, r)];
     }
-    
-    if(A->backward) A->backward(A);
-    if(B->backward) B->backward(B);
+    x->partials[task] = sum;
+}
 
-    return SUCCESS;
+// Recomputes each row's log-sum-exp rather than keeping it from the
+// forward pass, then writes scale * (softmax - onehot) in one sweep.
+static void tensor_xent_backward_task(void* ctx, size_t task, size_t worker) {
+    (void)worker;
+    tg_xent_t* x = ctx;
+    size_t end = (task + 1) * x->rows_per_task;
+    for (size_t r = task * x->rows_per_task; r < end && r < x->n_rows; r++) {
+        const tg_value_t* row = x->logits + r * x->n_classes;
+        tg_value_t* drow = x->dlogits + r * x->n_classes;
+        tg_simd->grad_softmax(drow, row, tg_simd->logsumexp(row, x->n_classes), x->scale, x->n_classes);
+        drow[tensor_xent_target(x, r)] -= x->scale;
+    }
 }
 
-tg_err_t tensor_backward_el_div(tg_tensor_t* tensor) {
-    assert(tensor->grads != NULL);
+// `scratch` receives the packed copies of inputs that are not contiguous.
+// Targets are data, so one that is not a class index (negative, fractional,
+// NaN or past the last class) fails with ERR_INVALID_TARGET rather than
+// indexing outside its row.
+static tg_err_t tensor_xent_plan(tg_tensor_t* logits, tg_tensor_t* targets, size_t* n_tasks,
+                                 tg_value_t* scratch[2], tg_xent_t* plan) {
+    size_t n_classes = logits->shape.dimensions[logits->shape.n_dimensions - 1];
+    assert(n_classes > 0 && "logits need at least one class");
+    tg_xent_t x = {
+        .n_classes = n_classes,
+        .n_rows = logits->n_elements / n_classes,
+    };
+    assert(x.n_rows > 0 && targets->n_elements == x.n_rows);
+    x.rows_per_task = n_classes < TG_XENT_TASK_ELEMENTS ? TG_XENT_TASK_ELEMENTS / n_classes : 1;
+    *n_tasks = (x.n_rows + x.rows_per_task - 1) / x.rows_per_task;
+    tg_err_t err = tensor_dense_vals(logits, &x.logits, &scratch[0]);
+    if (err == SUCCESS) {
+        err = tensor_dense_vals(targets, &x.targets, &scratch[1]);
+    }
+    for (size_t r = 0; err == SUCCESS && r < x.n_rows; r++) {
+        tg_value_t t = x.targets[r];
+        if (!(t >= 0 && t < (tg_value_t)n_classes && t == floorf(t))) { err = ERR_INVALID_TARGET; }
+    }
+    *plan = x;
+    return err;
+}
+
+// Mean cross-entropy of softmax(logits) over the last axis, against
+// `targets` holding one class index per row. Neither the softmax nor the
+// log-probabilities are materialized, in the forward or the backward pass.
+// A target that is not a class index panics with ERR_INVALID_TARGET here,
+// like other forward errors, and the backward pass returns it.
+tg_tensor_t* tensor_softmax_cross_entropy(tg_tensor_t* logits, tg_tensor_t* targets) {
+    assert(logits != NULL);
+    assert(targets != NULL);
+    assert(logits->shape.n_dimensions >= 1);
+    UNWRAP(tensor_realize(logits));
+    UNWRAP(tensor_realize(targets));
+
+    size_t n_tasks = 0;
+    tg_value_t* scratch[2] = { NULL, NULL };
+    tg_xent_t x = {0};
+    UNWRAP(tensor_xent_plan(logits, targets, &n_tasks, scratch, &x));
+
+    x.partials = malloc(n_tasks * sizeof(double));
+    if (!x.partials) { UNWRAP(ERR_MEMORY_ALLOCATION); }
+    tensor_parallel_for(n_tasks, tensor_get_num_threads(), tensor_xent_forward_task, &x);
+    double sum = 0.0;
+    for (size_t t = 0; t < n_tasks; t++) { sum += x.partials[t]; }
+    free(x.partials);
+    free(scratch[0]);
+    free(scratch[1]);
+
+    size_t dims[] = {1};
+    tg_tensor_t* tensor = NULL;
+    UNWRAP(tensor_init_uninit(dims, 1, &tensor));
+    tensor->vals[0] = (tg_value_t)(sum / (double)x.n_rows);
+
+    tensor_create_graph(tensor, logits, targets, TG_BOP_SOFTMAX_CROSS_ENTROPY);
+    return tensor;
+}
+
+static tg_err_t tensor_grad_softmax_cross_entropy(tg_tensor_t* C, tg_tensor_t* A, tg_tensor_t* B) {
+    if (!C->grads) { return SUCCESS; }
+    tg_value_t* dA = NULL;
+    tg_err_t err = tensor_grads_acquire(A, &dA);
+    if (err != SUCCESS || !dA) { return err; }
+
+    size_t n_tasks = 0;
+    tg_value_t* scratch[2] = { NULL, NULL };
+    tg_xent_t x = {0};
+    err = tensor_xent_plan(A, B, &n_tasks, scratch, &x);
+    if (err == SUCCESS) {
+        x.dlogits = dA;
+        x.scale = C->grads[0] / (tg_value_t)x.n_rows;
+        tensor_parallel_for(n_tasks, tensor_get_num_threads(), tensor_xent_backward_task, &x);
+    }
+    free(scratch[0]);
+    free(scratch[1]);
+    return err;
+}
 
+tg_err_t tensor_backward_softmax_cross_entropy(tg_tensor_t* tensor) {
     if(tensor->n_input_tensors == 0) {
         return SUCCESS;
     }
@@ -450,83 +4017,348 @@ tg_err_t tensor_backward_el_div(tg_tensor_t* tensor) {
     assert(tensor->n_input_tensors == 2);
     assert(tensor->input_tensors[0] != NULL);
     assert(tensor->input_tensors[1] != NULL);
-    assert(tensor->input_tensors[0]->shape.n_dimensions \
-           == tensor->input_tensors[1]->shape.n_dimensions);
 
-    tg_tensor_t* A = tensor->input_tensors[0];
-    tg_tensor_t* B = tensor->input_tensors[1];
+    return tensor_grad_softmax_cross_entropy(tensor, tensor->input_tensors[0], tensor->input_tensors[1]);
+}
+
+// ==============================
+//   Lazy elementwise fusion
+// ==============================
+void tensor_lazy_begin(void) {
+    tg_lazy_depth += 1;
+}
+
+void tensor_lazy_end(void) {
+    assert(tg_lazy_depth > 0);
+    tg_lazy_depth -= 1;
+}
+
+// Tape records hold exactly two inputs, so fusion is off while a tape is
+// recording.
+bool tensor_lazy_enabled(void) {
+    return tg_lazy_depth > 0 && tg_active_tape == NULL;
+}
 
-    for (size_t i = 0; i < tensor->n_elements; i++) {
-        A->grads[i] += tensor->grads[i] * (1/B->vals[i]);
-        B->grads[i] += tensor->grads[i] * ((-1 * A->vals[i]) / (B->vals[i] * B->vals[i]));
+static uint8_t tensor_fused_add_leaf(tg_fused_expr_t* expr, tg_tensor_t* leaf) {
+    for (size_t i = 0; i < expr->n_leaves; i++) {
+        if (expr->leaves[i] == leaf) { return (uint8_t)(TG_FUSED_LEAF | i); }
     }
-    
-    if(A->backward) A->backward(A);
-    if(B->backward) B->backward(B);
+    assert(expr->n_leaves < TG_FUSED_MAX_LEAVES);
+    expr->leaves[expr->n_leaves] = leaf;
+    expr->leaf_versions[expr->n_leaves] = tensor_version(leaf);
+    return (uint8_t)(TG_FUSED_LEAF | expr->n_leaves++);
+}
 
-    return SUCCESS;
+// Splices the program of a pending operand into `expr` and returns the slot
+// holding its value. Realized operands simply become leaves.
+static uint8_t tensor_fused_add_operand(tg_fused_expr_t* expr, tg_tensor_t* operand) {
+    if (!operand->pending) {
+        return tensor_fused_add_leaf(expr, operand);
+    }
+
+    const tg_fused_expr_t* sub = operand->lazy_expr;
+    uint8_t leaf_slots[TG_FUSED_MAX_LEAVES];
+    for (size_t i = 0; i < sub->n_leaves; i++) {
+        leaf_slots[i] = tensor_fused_add_leaf(expr, sub->leaves[i]);
+    }
+
+    size_t base = expr->n_ops;
+    for (size_t i = 0; i < sub->n_ops; i++) {
+        tg_fused_op_t op = sub->ops[i];
+        op.lhs = (op.lhs & TG_FUSED_LEAF) ? leaf_slots[op.lhs & ~TG_FUSED_LEAF] : (uint8_t)(base + op.lhs);
+        op.rhs = (op.rhs & TG_FUSED_LEAF) ? leaf_slots[op.rhs & ~TG_FUSED_LEAF] : (uint8_t)(base + op.rhs);
+        expr->ops[expr->n_ops++] = op;
+    }
+    return (uint8_t)(expr->n_ops - 1);
 }
 
-tg_tensor_t* tensor_el_add(tg_tensor_t* a, tg_tensor_t* b) {
+static size_t tensor_fused_n_ops(tg_tensor_t* t) {
+    return t->pending ? t->lazy_expr->n_ops : 0;
+}
+
+static size_t tensor_fused_n_leaves(tg_tensor_t* t) {
+    return t->pending ? t->lazy_expr->n_leaves : 1;
+}
+
+// Builds the output of a lazy elementwise op. The output is a single graph
+// node whose inputs are the leaves of the whole chain, so intermediates are
+// neither computed nor kept alive by the graph. Without grad tracking the
+// leaves are not referenced and must outlive the tensor's realization.
+static tg_tensor_t* tensor_lazy_binary(tg_tensor_t* a, tg_tensor_t* b, enum tg_backward_op op) {
+    // Start a new chain when the combined program would not fit. The
+    // operand programs are not deduplicated, so this is conservative.
+    bool fits = tensor_fused_n_ops(a) + (a == b ? 0 : tensor_fused_n_ops(b)) + 1 <= TG_FUSED_MAX_OPS
+             && tensor_fused_n_leaves(a) + tensor_fused_n_leaves(b) <= TG_FUSED_MAX_LEAVES;
+    if (!fits) {
+        UNWRAP(tensor_realize(a));
+        UNWRAP(tensor_realize(b));
+    }
+
     tg_tensor_t* tensor = NULL;
-    UNWRAP(tensor_init(a->shape.dimensions, a->shape.n_dimensions, &tensor));
+    UNWRAP(tensor_init_uninit(a->shape.dimensions, a->shape.n_dimensions, &tensor));
+    tg_fused_expr_t* expr = tensor_alloc_for(tensor, sizeof(tg_fused_expr_t));
+    if (!expr) { UNWRAP(ERR_MEMORY_ALLOCATION); }
 
-    for(size_t i = 0; i< tensor->n_elements; i++) {
-        tensor->vals[i] = a->vals[i] + b->vals[i];
+    uint8_t lhs = tensor_fused_add_operand(expr, a);
+    uint8_t rhs = a == b ? lhs : tensor_fused_add_operand(expr, b);
+    expr->ops[expr->n_ops++] = (tg_fused_op_t){ .op = op, .lhs = lhs, .rhs = rhs };
+
+    tensor->lazy_expr = expr;
+    tensor->pending = true;
+
+    bool any_requires_grad = false;
+    for (size_t i = 0; i < expr->n_leaves; i++) {
+        any_requires_grad |= expr->leaves[i]->requires_grad;
+    }
+    tensor->requires_grad = tensor_grad_enabled() && any_requires_grad;
+    if (!tensor->requires_grad) {
+        return tensor;
     }
 
-    tensor_create_graph(tensor, a, b, TG_BOP_EL_ADD);
+    tensor->n_input_tensors = expr->n_leaves;
+    tensor->input_tensors = expr->leaves;
+    tensor->backward = tensor_backward_fused;
+    tensor->op = TG_BOP_FUSED_ELEMENTWISE;
+    if (tensor->alloc != TG_ALLOC_ARENA) {
+        for (size_t i = 0; i < expr->n_leaves; i++) {
+            expr->leaves[i]->ref_count += 1;
+        }
+    }
     return tensor;
 }
 
-tg_tensor_t* tensor_el_sub(tg_tensor_t* a, tg_tensor_t* b) {
-    tg_tensor_t* tensor = NULL;
-    UNWRAP(tensor_init(a->shape.dimensions, a->shape.n_dimensions, &tensor));
+static const tg_value_t* tensor_fused_operand(const tg_fused_expr_t* expr, uint8_t slot,
+                                              tg_value_t vals[][TG_FUSED_BLOCK], size_t base) {
+    if (slot & TG_FUSED_LEAF) {
+        return expr->leaves[slot & ~TG_FUSED_LEAF]->vals + base;
+    }
+    return vals[slot];
+}
 
-    for(size_t i = 0; i< tensor->n_elements; i++) {
-        tensor->vals[i] = a->vals[i] - b->vals[i];
+// Evaluates every op of the program for elements [base, base + n) into the
+// per-op block buffers, which stay in L1 across the whole chain.
+static void tensor_fused_eval_block(const tg_fused_expr_t* expr, tg_value_t vals[][TG_FUSED_BLOCK],
+                                    size_t base, size_t n) {
+    for (size_t k = 0; k < expr->n_ops; k++) {
+        const tg_fused_op_t* op = &expr->ops[k];
+        tensor_el_forward_kernel(op->op,
+                                 tensor_fused_operand(expr, op->lhs, vals, base),
+                                 tensor_fused_operand(expr, op->rhs, vals, base),
+                                 vals[k], n);
     }
+}
 
-    tensor_create_graph(tensor, a, b, TG_BOP_EL_SUB);
-    return tensor;
+tg_err_t tensor_realize(tg_tensor_t* tensor) {
+    assert(tensor != NULL);
+    if (!tensor->pending) {
+        return SUCCESS;
+    }
+
+    const tg_fused_expr_t* expr = tensor->lazy_expr;
+    tg_value_t vals[TG_FUSED_MAX_OPS][TG_FUSED_BLOCK];
+    for (size_t base = 0; base < tensor->n_elements; base += TG_FUSED_BLOCK) {
+        size_t n = tensor->n_elements - base < TG_FUSED_BLOCK ? tensor->n_elements - base : TG_FUSED_BLOCK;
+        tensor_fused_eval_block(expr, vals, base, n);
+        memcpy(tensor->vals + base, vals[expr->n_ops - 1], n * sizeof(tg_value_t));
+    }
+    tensor->pending = false;
+    return SUCCESS;
 }
 
-tg_tensor_t* tensor_el_mul(tg_tensor_t* a, tg_tensor_t* b) {
-    tg_tensor_t* tensor = NULL;
-    UNWRAP(tensor_init(a->shape.dimensions, a->shape.n_dimensions, &tensor));
+// Fused backward: per block, recompute the chain's intermediates in L1 and
+// run reverse mode through the program, so only the leaves' values and
+// grads and the output's grads touch memory.
+tg_err_t tensor_backward_fused(tg_tensor_t* tensor) {
+    if (!tensor->grads) {
+        return SUCCESS;
+    }
 
-    for(size_t i = 0; i< tensor->n_elements; i++) {
-        tensor->vals[i] = a->vals[i] * b->vals[i];
+    const tg_fused_expr_t* expr = tensor->lazy_expr;
+    assert(expr != NULL);
+
+    // The intermediates are recomputed from the leaves, so any op that reads
+    // its operands makes every leaf a saved input.
+    bool reads_leaves = false;
+    for (size_t k = 0; k < expr->n_ops; k++) {
+        reads_leaves |= tg_bop_saves_inputs[expr->ops[k].op];
+    }
+    for (size_t i = 0; reads_leaves && i < expr->n_leaves; i++) {
+        if (tensor_version(expr->leaves[i]) != expr->leaf_versions[i]) {
+            return ERR_SAVED_TENSOR_MODIFIED;
+        }
     }
 
-    tensor_create_graph(tensor, a, b, TG_BOP_EL_MUL);
-    return tensor;
+    tg_value_t* leaf_grads[TG_FUSED_MAX_LEAVES];
+    for (size_t i = 0; i < expr->n_leaves; i++) {
+        tg_err_t err = tensor_grads_acquire(expr->leaves[i], &leaf_grads[i]);
+        if (err != SUCCESS) { return err; }
+    }
+
+    tg_value_t vals[TG_FUSED_MAX_OPS][TG_FUSED_BLOCK];
+    tg_value_t dvals[TG_FUSED_MAX_OPS][TG_FUSED_BLOCK];
+    size_t last = expr->n_ops - 1;
+
+    for (size_t base = 0; base < tensor->n_elements; base += TG_FUSED_BLOCK) {
+        size_t n = tensor->n_elements - base < TG_FUSED_BLOCK ? tensor->n_elements - base : TG_FUSED_BLOCK;
+        tensor_fused_eval_block(expr, vals, base, n);
+
+        memset(dvals, 0, last * sizeof(dvals[0]));
+        memcpy(dvals[last], tensor->grads + base, n * sizeof(tg_value_t));
+
+        for (size_t k = expr->n_ops; k-- > 0;) {
+            const tg_fused_op_t* op = &expr->ops[k];
+            const tg_value_t* d = dvals[k];
+            const tg_value_t* x = tensor_fused_operand(expr, op->lhs, vals, base);
+            const tg_value_t* y = tensor_fused_operand(expr, op->rhs, vals, base);
+            tg_value_t* dx = (op->lhs & TG_FUSED_LEAF) ? leaf_grads[op->lhs & ~TG_FUSED_LEAF] : dvals[op->lhs];
+            tg_value_t* dy = (op->rhs & TG_FUSED_LEAF) ? leaf_grads[op->rhs & ~TG_FUSED_LEAF] : dvals[op->rhs];
+            if (dx && (op->lhs & TG_FUSED_LEAF)) { dx += base; }
+            if (dy && (op->rhs & TG_FUSED_LEAF)) { dy += base; }
+
+            tensor_el_grad_kernel(op->op, dx, dy, d, x, y, n);
+        }
+    }
+    return SUCCESS;
 }
 
-tg_tensor_t* tensor_el_div(tg_tensor_t* a, tg_tensor_t* b) {
-    tg_tensor_t* tensor = NULL;
-    UNWRAP(tensor_init(a->shape.dimensions, a->shape.n_dimensions, &tensor));
+// In-place variants: a <- a op b, reusing a's buffer; b may broadcast to a's
+// shape. b must not share elements with a unless it is a itself (asserted),
+// since a view of the same storage could be overwritten before it is read.
+// They are not recorded in the graph, so while grad is enabled they
+// refuse operands that require grad with ERR_INPLACE_REQUIRES_GRAD (use them
+// under TENSOR_NO_GRAD or on tensors that are not part of a graph); each call
+// bumps the version of a's storage, so a pending backward that saved `a`
+// fails with ERR_SAVED_TENSOR_MODIFIED instead of silently using the new values.
+#define TENSOR_EL_INPLACE_OP(a, b, op) \
+		do { \
+				assert((a) != NULL); \
+				assert((b) != NULL); \
+				if (tensor_grad_enabled() && ((a)->requires_grad || (b)->requires_grad)) { \
+						return ERR_INPLACE_REQUIRES_GRAD; \
+				} \
+				assert(!tensor_inplace_overlaps((a), (b)) && "in-place destination overlaps its operand"); \
+				UNWRAP(tensor_realize(a)); \
+				UNWRAP(tensor_realize(b)); \
+				if (tensor_flat_pair((a), (b))) { \
+						tensor_el_forward_kernel((op), (a)->vals, (b)->vals, (a)->vals, (a)->n_elements); \
+				} else { \
+						assert(tensor_broadcast_rank((a), (b)) == (a)->shape.n_dimensions); \
+						size_t dims_[(a)->shape.n_dimensions]; \
+						tensor_broadcast_dims((a), (b), dims_, (a)->shape.n_dimensions); \
+						assert(memcmp(dims_, (a)->shape.dimensions, sizeof(dims_)) == 0 && "b must broadcast to a's shape"); \
+						tensor_el_broadcast_forward((op), (a), (b), (a)); \
+				} \
+				tensor_bump_version(a); \
+		} while (0)
 
-    for(size_t i = 0; i< tensor->n_elements; i++) {
-        tensor->vals[i] = a->vals[i] / b->vals[i];
+tg_err_t tensor_el_add_(tg_tensor_t* a, tg_tensor_t* b) {
+    TENSOR_EL_INPLACE_OP(a, b, TG_BOP_EL_ADD);
+    return SUCCESS;
+}
+
+tg_err_t tensor_el_sub_(tg_tensor_t* a, tg_tensor_t* b) {
+    TENSOR_EL_INPLACE_OP(a, b, TG_BOP_EL_SUB);
+    return SUCCESS;
+}
+
+tg_err_t tensor_el_mul_(tg_tensor_t* a, tg_tensor_t* b) {
+    TENSOR_EL_INPLACE_OP(a, b, TG_BOP_EL_MUL);
+    return SUCCESS;
+}
+
+tg_err_t tensor_el_div_(tg_tensor_t* a, tg_tensor_t* b) {
+    TENSOR_EL_INPLACE_OP(a, b, TG_BOP_EL_DIV);
+    return SUCCESS;
+}
+
+// Leading dimensions are a batch: [..., M, K] x [..., K, N] -> [..., M, N].
+// Both operands carry the same batch dimensions, or one of them is a plain
+// matrix shared by every item of the other's batch.
+static tg_matmul_dims_t tensor_matmul_dims(tg_tensor_t* a, tg_tensor_t* b) {
+    size_t rank_a = a->shape.n_dimensions;
+    size_t rank_b = b->shape.n_dimensions;
+    assert(rank_a >= 2 && rank_b >= 2);
+    assert(rank_a == rank_b || rank_a == 2 || rank_b == 2);
+
+    tg_matmul_dims_t d = {
+        .M = a->shape.dimensions[rank_a - 2],
+        .K = a->shape.dimensions[rank_a - 1],
+        .N = b->shape.dimensions[rank_b - 1],
+    };
+    assert(b->shape.dimensions[rank_b - 2] == d.K);
+
+    tg_tensor_t* batched = rank_a >= rank_b ? a : b;
+    d.batch = 1;
+    for (size_t i = 0; i + 2 < batched->shape.n_dimensions; i++) {
+        assert(rank_a == 2 || rank_b == 2 || a->shape.dimensions[i] == b->shape.dimensions[i]);
+        d.batch *= batched->shape.dimensions[i];
     }
+    d.a_stride = rank_a == 2 ? 0 : d.M * d.K;
+    d.b_stride = rank_b == 2 ? 0 : d.K * d.N;
+    return d;
+}
+
+tg_tensor_t* tensor_matmul(tg_tensor_t* a, tg_tensor_t* b) {
+    assert(a != NULL);
+    assert(b != NULL);
+    UNWRAP(tensor_realize(a));
+    UNWRAP(tensor_realize(b));
+
+    tg_matmul_dims_t d = tensor_matmul_dims(a, b);
+    tg_tensor_t* batched = a->shape.n_dimensions >= b->shape.n_dimensions ? a : b;
+    size_t n_dims = batched->shape.n_dimensions;
+    size_t dims[n_dims];
+    memcpy(dims, batched->shape.dimensions, (n_dims - 2) * sizeof(size_t));
+    dims[n_dims - 2] = d.M;
+    dims[n_dims - 1] = d.N;
+
+    // Views that are not contiguous are packed first.
+    const tg_value_t* a_vals = NULL;
+    const tg_value_t* b_vals = NULL;
+    tg_value_t* a_scratch = NULL;
+    tg_value_t* b_scratch = NULL;
+    UNWRAP(tensor_dense_vals(a, &a_vals, &a_scratch));
+    UNWRAP(tensor_dense_vals(b, &b_vals, &b_scratch));
 
-    tensor_create_graph(tensor, a, b, TG_BOP_EL_DIV);
+    tg_tensor_t* tensor = NULL;
+    UNWRAP(tensor_init_uninit(dims, n_dims, &tensor));
+    tg_gemm_batch_t g = {
+        .M = d.M, .N = d.N, .K = d.K,
+        .a = a_vals, .lda = d.K, .a_stride = d.a_stride,
+        .b = b_vals, .ldb = d.N, .b_stride = d.b_stride,
+        .c = tensor->vals, .ldc = d.N, .c_stride = d.M * d.N,
+    };
+    UNWRAP(tensor_gemm_batched(&g, d.batch));
+    free(a_scratch);
+    free(b_scratch);
+
+    tensor_create_graph(tensor, a, b, TG_BOP_MAT_MUL);
     return tensor;
 }
 
-float tensor_dot_product(tg_tensor_t* a, tg_tensor_t* b) {
+double tensor_dot_product_f64(tg_tensor_t* a, tg_tensor_t* b) {
     assert(a != NULL);
     assert(b != NULL);
     assert(a->vals != NULL);
     assert(b->vals != NULL);
     assert(a->n_elements == b->n_elements);
+    UNWRAP(tensor_realize(a));
+    UNWRAP(tensor_realize(b));
 
-    tg_value_t result = 0.0f;
-    for(size_t i = 0; i < a->n_elements; ++i) {
-        result += a->vals[i] * b->vals[i];
-    }
-    return result;
+    const tg_value_t* a_vals = NULL;
+    const tg_value_t* b_vals = NULL;
+    tg_value_t* a_scratch = NULL;
+    tg_value_t* b_scratch = NULL;
+    UNWRAP(tensor_dense_vals(a, &a_vals, &a_scratch));
+    UNWRAP(tensor_dense_vals(b, &b_vals, &b_scratch));
+    double dot = tensor_dot_pairwise(a_vals, b_vals, a->n_elements);
+    free(a_scratch);
+    free(b_scratch);
+    return dot;
+}
+
+tg_value_t tensor_dot_product(tg_tensor_t* a, tg_tensor_t* b) {
+    return (tg_value_t)tensor_dot_product_f64(a, b);
 }
 
 
@@ -541,21 +4373,31 @@ float tensor_dot_product(tg_tensor_t* a, tg_tensor_t* b) {
 //            Utils
 // ==============================
 void tensor_print(tg_tensor_t* tensor) {
+    UNWRAP(tensor_realize(tensor));
 
     if(tensor->n_elements == 0) {
         printf("Tensor {\n}\n");
         return;
     }
 
+    const tg_value_t* vals = NULL;
+    tg_value_t* scratch = NULL;
+    UNWRAP(tensor_dense_vals(tensor, &vals, &scratch));
     printf("Tensor {\n\t");
     for(size_t i = 0; i< tensor->n_elements; i++) {
-        printf("[%0.03f] ", tensor->vals[i]);
+        printf("[%0.03f] ", vals[i]);
         if (i != 0 && (i+1) % 3 == 0) { printf("\n\t");}
     }
     printf("\r}\n");
+    free(scratch);
 }
 
 void tensor_print_grads(tg_tensor_t* tensor) {
+    if(tensor->grads == NULL) {
+        printf("Tensor Gradients {\n}\n");
+        return;
+    }
+
     printf("Tensor Gradients {\n\t");
     for(size_t i = 0; i< tensor->n_elements; i++) {
         printf("[%0.03f] ", tensor->grads[i]);